@@ -29,7 +29,13 @@
 #include "Utils/Image/ImageIO.h"
 #include "Core/Program/ProgramManager.h"
 #include "Core/AssetResolver.h"
+#include "Utils/Timing/CpuTimer.h"
 #include "Parallax.h"
+#include "ParallaxCpu/ImageIO.h"
+#include "ParallaxCpu/Parallel.h"
+#include "ParallaxCpu/Renderer.h"
+#include <algorithm>
+#include <cstring>
 #include <string>
 using namespace std::string_literals;
 
@@ -56,12 +62,24 @@ namespace
         {3, "3: Cone step mapping"},
         {10, "4(10): Seidel's Maximum Mip tracing"},
         {11, "5(11): Drobot's QDM tracing"},
+        {12, "6(12): QDM on the bilinear-conservative pyramid"},
+        {13, "7(13): Cone steps, then Maximum Mip"},
+        {14, "8(14): Procedural, Lipschitz bounds"},
     };
     const char kRefinementFunDefine[] = "REFINE_FUN";
     const Gui::DropdownList kRefinementFunList = {
         {0, "0: No refinement"},
         {1, "1: Linear approx"},
         {2, "2: Binary search"},
+        {3, "3: Secant (Illinois)"},
+        {4, "4: Bilinear patch"},
+    };
+    const char kShadowFunDefine[] = "SHADOW_FUN";
+    const Gui::DropdownList kShadowFunList = {
+        {0, "0: No shadows"},
+        {1, "1: Linear search"},
+        {2, "2: Cone steps"},
+        {3, "3: Cone steps, soft"},
     };
     const char kHeightFunDefine[] = "HEIGHT_FUN";
     const Gui::DropdownList kHeightFunList = {
@@ -77,10 +95,8 @@ namespace
     const Gui::DropdownList kDebugTexList = {
         {0, "Heightmap"},
         {1, "Conemap"},
-        //{2, "Min max"},
+        {2, "Height pyramid"},
         {3, "Loaded albedo map"},
-        {4, "Max mip map"},
-        {5, "QDM"},
     };
     const Gui::DropdownList kDebugChannelList = {
         {0, "X RED"},
@@ -100,6 +116,16 @@ std::string filenameFromPath(const std::string& path)
     return (std::string::npos != pos) ? path.substr(pos + 1) : path;
 }
 
+// Levels of the virtual power of two quadtree over a texture (its root node covers the whole texture);
+// equals getMipCount() - 1 for power of two sizes, one more for NPOT sizes
+uint32_t virtualQuadtreeLevels(const Texture* const tex)
+{
+    uint32_t levels = 0;
+    while ((1u << levels) < std::max(tex->getWidth(), tex->getHeight()))
+        ++levels;
+    return levels;
+}
+
 std::string TextureDescription(const Texture* const tex) {
     if (!tex) return "  [ no texture ]";
 
@@ -148,6 +174,12 @@ void Parallax::onGuiRender(Gui* pGui)
         {
             mRenderSettings.setRefinementFun();
         }
+        if (w.dropdown(kShadowFunDefine, kShadowFunList, mRenderSettings.selectedShadowFun))
+        {
+            mRenderSettings.setShadowFun();
+        }
+        w.tooltip("Self-shadowing: a shadow ray from the hit towards the light. The cone steps use the last unrelaxed cone map (Dummer's or a quick conemap),\n"
+                  "or bake a quick conemap for the shadows if there is none", true);
         w.separator();
         guiTexureInfo(mainGroup);
         w.separator();
@@ -227,18 +259,18 @@ void Parallax::guiTexureInfo(Gui::Widgets& parent)
         if (tx && tx.get() == last) w.text("IN USE", true);
         w.text(sizeText);
     }
-    if ((mpQDMTex || w.button("---")) && w.button("Use##QDM"))
+    if ((mpHeightPyramidTex || w.button("---")) && w.button("Use##QDM"))
     {
-        pParallaxVars["gTexture"] = mpQDMTex;
+        pParallaxVars["gTexture"] = mpHeightPyramidTex;
     }
     w.text("QDM MAP", true);
     w.tooltip("Don't forget to set `PARALLAX_FUN`");
     {
         static const Texture* last = nullptr;
         static std::string sizeText = TextureDescription(last);
-        if (last != mpQDMTex.get())
+        if (last != mpHeightPyramidTex.get())
         {
-            last = mpQDMTex.get();
+            last = mpHeightPyramidTex.get();
             sizeText = TextureDescription(last);
         }
         const auto& tx = pParallaxVars["gTexture"].getTexture();
@@ -246,19 +278,19 @@ void Parallax::guiTexureInfo(Gui::Widgets& parent)
             w.text("IN USE", true);
         w.text(sizeText);
     }
-    if ((mpMaxMipTex || w.button("---"))  && w.button("Use##MaxMip"))
+    if ((mpHeightPyramidTex || w.button("---"))  && w.button("Use##MaxMip"))
     {
         // WARNING: different texture
-        pParallaxVars["MaxMipTexture"] = mpMaxMipTex;
+        pParallaxVars["MaxMipTexture"] = mpHeightPyramidTex;
     }
     w.text("MaxMip MAP", true);
     w.tooltip("Don't forget to set `PARALLAX_FUN`");
     {
         static const Texture* last = nullptr;
         static std::string sizeText = TextureDescription(last);
-        if (last != mpMaxMipTex.get())
+        if (last != mpHeightPyramidTex.get())
         {
-            last = mpMaxMipTex.get();
+            last = mpHeightPyramidTex.get();
             sizeText = TextureDescription(last);
         }
         const auto& tx = pParallaxVars["MaxMipTexture"].getTexture(); // WARNING: Different texture
@@ -303,10 +335,27 @@ void Parallax::guiRenderSettings(Gui::Widgets& parent)
     w.tooltip("Discard fragments when the ray misses the Heightmap, otherwise the pixel is colored red.", true);
     w.checkbox("Debug: display non-converged", mRenderSettings.displayNonConverged);
     w.tooltip("Color fragments to magenta if the primary search is not converged.", true);
+    if (w.checkbox("Debug: trace statistics", mTraceStats.enabled))
+    {
+        mpParallaxProgram->addDefine("TRACE_STATS", mTraceStats.enabled ? "1" : "0");
+    }
+    w.tooltip("Count the primary steps, refinement steps and texture fetches of every pixel (TRACE_STATS)", true);
+    if (mTraceStats.enabled)
+    {
+        if (w.button("Log trace statistics"))
+            mTraceStats.logNextFrame = true;
+        w.var("Heatmap scale", mTraceStats.heatmapScale, 0.0f, 1000.0f);
+        w.tooltip("The count shown in red in the saved heatmaps, 0: the p99 of the frame", true);
+    }
     w.slider("Max step number", mRenderSettings.stepNum, 2U, 200U);
     w.tooltip("Step number for iterative primary searches", true);
     w.slider("Max refine step number", mRenderSettings.refineStepNum, 0U, 20U);
     w.tooltip("Step number for iterative refinement searches", true);
+    if (mRenderSettings.selectedRefinementFun == 3)
+    {
+        w.slider("Refine epsilon (texels)", mRenderSettings.refineEpsilon, 0.01f, 1.0f);
+        w.tooltip("The secant refinement stops once the interval along the ray is shorter than this", true);
+    }
     w.slider("Relax multiplier", mRenderSettings.relax, 1.0f, 8.0f);
     w.tooltip("Primary search step relaxation", true);
     if (w.checkbox("BILINEAR_BY_HAND", mRenderSettings.BILINEAR_BY_HAND))
@@ -317,6 +366,30 @@ void Parallax::guiRenderSettings(Gui::Widgets& parent)
     {
         mpParallaxProgram->addDefine("CONSERVATIVE_STEP", mRenderSettings.CONSERVATIVE_STEP ? "1" : "0");
     }
+    if (w.checkbox("ADAPTIVE_STEPS", mRenderSettings.ADAPTIVE_STEPS))
+    {
+        mpParallaxProgram->addDefine("ADAPTIVE_STEPS", mRenderSettings.ADAPTIVE_STEPS ? "1" : "0");
+    }
+    w.tooltip("Per ray step budgets: the primary steps follow the texels the ray crosses per pixel footprint,\n"
+              "the refinement stops once the hit is resolved to the pixel footprint. The step numbers above are the limits.", true);
+    if (mRenderSettings.ADAPTIVE_STEPS)
+    {
+        w.slider("Adaptive steps per texel", mRenderSettings.adaptiveStepsPerTexel, 0.5f, 8.0f);
+        w.tooltip("Primary steps per texel that the ray crosses, for pixels that cover at most one texel", true);
+    }
+    if (mRenderSettings.selectedShadowFun == 3)
+    {
+        w.slider("Shadow softness", mRenderSettings.shadowSoftness, 0.005f, 0.5f);
+        w.tooltip("The tan of the light's angular radius: the width of the penumbrae", true);
+    }
+    if (mRenderSettings.selectedParallaxFun == 13)
+    {
+        w.slider("Hybrid switch step", mRenderSettings.hybridMinStep, 0.0f, 16.0f);
+        w.tooltip("Switch from cone steps to Maximum Mip after a cone step shorter than this many texels.\n"
+                  "Needs the cone map and the height pyramid of the same heightmap.", true);
+        w.slider("Hybrid cone steps", mRenderSettings.hybridConeSteps, 0U, 200U);
+        w.tooltip("Switch to Maximum Mip after this many cone steps at the latest", true);
+    }
     w.separator();
 
     w.text("Transformation");
@@ -346,11 +419,10 @@ void Parallax::guiProceduralGeneration(Gui::Widgets& parent)
         mRunHeightmapCompute = true;
         getDevice()->getProgramManager()->addGlobalDefines({{"USE_ALBEDO_TEXTURE", "0"}});
         mpConeTex.reset();
-        mpMinmaxTex.reset();
-        mpQDMTex.reset();
-        mpMaxMipTex.reset();
+        mpShadowConeTex.reset();
+        mpHeightPyramidTex.reset();
     }
-    w.tooltip("Generates a Heightmap; deletes the Conemap");
+    w.tooltip("Generates a Heightmap; deletes the Conemap. PARALLAX_FUN 8(14) traces the function directly, without generating it");
     w.release();
 }
 void Parallax::guiConemapGeneration(Gui::Widgets& parent)
@@ -422,34 +494,66 @@ void Parallax::guiQuickconemapGeneration(Gui::Widgets& parent)
         "Guarantees conservative bilinear interpolation for cones.\n"
         "Works with relaxed and simple cone maps (if they were correctly generated)"
     );
+    w.checkbox("Generate on CPU##quickconemap", mQCMCompSettings.useCpu);
+    w.tooltip("Reads back the heightmap and runs the multithreaded CPU generator; the bake time is logged", true);
+    if (mQCMCompSettings.useCpu)
+    {
+        w.slider("Exact texels %##quickconemap", mQCMCompSettings.exactTexelPercent, 0.0f, 100.0f);
+        w.tooltip("Hybrid bake: the texels with the narrowest quick cones get the exact falling edge cone", true);
+        w.slider("Exact time budget (ms)##quickconemap", mQCMCompSettings.exactTimeBudgetMs, 0.0f, 10000.0f);
+        w.tooltip("Stops the exact refinement after this much bake time; 0: no limit", true);
+    }
 
     {
         static bool everyFrame = false;
         //w.checkbox("gen every frame##quickconemap", everyFrame);
         if (everyFrame)
         {
-            mRunMinmaxCompute = true;
+            mpHeightPyramidTex.reset();
             mRunQuickConemapCompute = true;
         }
     }
     if (w.button("Generate Quick Conemap - naive") && mpQuickConemapCompute)
     {
-        mRunMinmaxCompute = true;
         mRunQuickConemapCompute = true;
         mQCMCompSettings.algorithm = "1";
         mQCMCompSettings.name = "Naive Quick Conemap"s + (mQCMCompSettings.maxAtTexelCenter ? " + Center Heuristic" : "");
         if (mQCMCompSettings.POSTPROCESS_MIN)
             mQCMCompSettings.name += " + PostProcessed";
+        if (mQCMCompSettings.useCpu)
+            mQCMCompSettings.name += mQCMCompSettings.exactTexelPercent > 0 ? " (CPU + Exact)" : " (CPU)";
     }
     if (w.button("Generate Quick Conemap - region growing 3x3") && mpQuickConemapCompute)
     {
-        mRunMinmaxCompute = true;
         mRunQuickConemapCompute = true;
         mQCMCompSettings.algorithm = "2";
         mQCMCompSettings.name = "Quick Conemap"s + (mQCMCompSettings.maxAtTexelCenter ? " + Center Heuristic" : "");
         if (mQCMCompSettings.POSTPROCESS_MIN)
             mQCMCompSettings.name += " + PostProcessed";
+        if (mQCMCompSettings.useCpu)
+            mQCMCompSettings.name += mQCMCompSettings.exactTexelPercent > 0 ? " (CPU + Exact)" : " (CPU)";
+    }
+    if (w.button("Generate Quick Conemap - region growing 5x5") && mpQuickConemapCompute)
+    {
+        mRunQuickConemapCompute = true;
+        mQCMCompSettings.algorithm = "3";
+        mQCMCompSettings.name = "Quick Conemap 5x5"s + (mQCMCompSettings.maxAtTexelCenter ? " + Center Heuristic" : "");
+        if (mQCMCompSettings.POSTPROCESS_MIN)
+            mQCMCompSettings.name += " + PostProcessed";
+        if (mQCMCompSettings.useCpu)
+            mQCMCompSettings.name += mQCMCompSettings.exactTexelPercent > 0 ? " (CPU + Exact)" : " (CPU)";
+    }
+    if (w.button("Generate Quick Conemap - region growing 7x7") && mpQuickConemapCompute)
+    {
+        mRunQuickConemapCompute = true;
+        mQCMCompSettings.algorithm = "4";
+        mQCMCompSettings.name = "Quick Conemap 7x7"s + (mQCMCompSettings.maxAtTexelCenter ? " + Center Heuristic" : "");
+        if (mQCMCompSettings.POSTPROCESS_MIN)
+            mQCMCompSettings.name += " + PostProcessed";
+        if (mQCMCompSettings.useCpu)
+            mQCMCompSettings.name += mQCMCompSettings.exactTexelPercent > 0 ? " (CPU + Exact)" : " (CPU)";
     }
+    w.tooltip("Checks a wider window of nodes on every level: wider cones for a longer bake", true);
     w.release();
 }
 void Parallax::guiQDMGeneration(Gui::Widgets& parent)
@@ -463,6 +567,7 @@ void Parallax::guiQDMGeneration(Gui::Widgets& parent)
         //w.checkbox("gen every frame##qdm", everyFrame);
         if (everyFrame)
         {
+            mpHeightPyramidTex.reset();
             mRunQDMCompute = true;
         }
     }
@@ -470,6 +575,13 @@ void Parallax::guiQDMGeneration(Gui::Widgets& parent)
     {
         mRunQDMCompute = true;
     }
+    w.tooltip("Uses the height pyramid shared with Maximum Mip mapping and the quick conemap; it is only generated once per heightmap");
+    if (w.checkbox("Height pyramid min channel", mHeightPyramidWithMin))
+        resetHeightPyramid();
+    w.tooltip("Also keep the min heights in the pyramid (RGBA instead of RG)");
+    if (w.checkbox("Height pyramid border channel", mHeightPyramidWithBorder))
+        resetHeightPyramid();
+    w.tooltip("Also keep the max heights with a one texel border in the pyramid (RGBA instead of RG), needed by PARALLAX_FUN 12");
     w.release();
 }
 void Parallax::guiMaxMipGeneration(Gui::Widgets& parent)
@@ -483,6 +595,7 @@ void Parallax::guiMaxMipGeneration(Gui::Widgets& parent)
         //w.checkbox("gen every frame##maxmip", everyFrame);
         if (everyFrame)
         {
+            mpHeightPyramidTex.reset();
             mRunMaxMipCompute = true;
         }
     }
@@ -552,10 +665,8 @@ void Parallax::guiDebugRender(Gui::Widgets& parent)
             {
             case 0: mpDebugTex = mpHeightmapTex; break;
             case 1: mpDebugTex = mpConeTex; break;
-            case 2: mpDebugTex = mpMinmaxTex; break;
+            case 2: mpDebugTex = mpHeightPyramidTex; break;
             case 3: mpDebugTex = mpAlbedoTex; break;
-            case 4: mpDebugTex = mpMaxMipTex; break;
-            case 5: mpDebugTex = mpQDMTex; break;
             }
         }
         w.slider("Mip level", mDebugSettings.mipLevel, (uint32_t)0, mpDebugTex ? mpDebugTex->getMipCount() - 1 : 0);
@@ -593,6 +704,24 @@ void Parallax::guiSaveImage(Gui::Widgets& parent)
             doSaveTexture = 2;
         }
     }
+    if (w.button("Render frame on CPU") && mpHeightmapTex) {
+        if (saveFileDialog({ {"png","PNG"} }, saveFilePath)) {
+            doSaveTexture = 3;
+        }
+    }
+    w.tooltip("Reference frame of the current settings and camera, rendered by ParallaxCpu::Renderer (without the albedo texture)");
+    if (w.button("Record rays") && mpHeightmapTex) {
+        if (saveFileDialog({ {"rays","Ray set"} }, saveFilePath)) {
+            doSaveTexture = 5;
+        }
+    }
+    w.tooltip("The (u, u2) rays of every pixel of the current view, to replay with ParallaxCpuRayBench");
+    if (mTraceStats.enabled && w.button("Save trace statistics heatmaps")) {
+        if (saveFileDialog({ {"png","PNG"} }, saveFilePath)) {
+            doSaveTexture = 4;
+        }
+    }
+    w.tooltip("Writes <name>_steps.png and <name>_fetches.png of the next frame and logs the statistics");
     w.release();
 }
 
@@ -633,12 +762,17 @@ void Parallax::RenderSettings::setRefinementFun() {
     app.getDevice()->getProgramManager()->addGlobalDefines({{kRefinementFunDefine, std::to_string(selectedRefinementFun)}});
 }
 
+void Parallax::RenderSettings::setShadowFun() {
+    app.getDevice()->getProgramManager()->addGlobalDefines({{kShadowFunDefine, std::to_string(selectedShadowFun)}});
+}
+
 void Parallax::onLoad(RenderContext* pRenderContext)
 {
     getDevice()->getProgramManager()->addGlobalDefines(
             {
             {kParallaxFunDefine, std::to_string(mRenderSettings.selectedParallaxFun )},
             {kRefinementFunDefine, std::to_string(mRenderSettings.selectedRefinementFun )},
+            {kShadowFunDefine, std::to_string(mRenderSettings.selectedShadowFun )},
             }
     );
     getDevice()->getProgramManager()->setGlobalCompilerArguments({"-Wno-30081", "-Wno-15401", "-Wno-15205"});
@@ -652,7 +786,9 @@ void Parallax::onLoad(RenderContext* pRenderContext)
         mpParallaxProgram = Program::create( getDevice(), d );
         mpParallaxProgram->addDefine("BILINEAR_BY_HAND", mRenderSettings.BILINEAR_BY_HAND ? "1" : "0");
         mpParallaxProgram->addDefine("CONSERVATIVE_STEP", mRenderSettings.CONSERVATIVE_STEP ? "1" : "0");
+        mpParallaxProgram->addDefine("ADAPTIVE_STEPS", mRenderSettings.ADAPTIVE_STEPS ? "1" : "0");
         mpParallaxProgram->addDefine("DO_SQRT_LOOKUP", mCMCompSettings.DO_SQRT_LOOKUP ? "1" : "0");
+        mpParallaxProgram->addDefine("TRACE_STATS", mTraceStats.enabled ? "1" : "0");
     }
 
     // debug texture program
@@ -686,14 +822,10 @@ void Parallax::onLoad(RenderContext* pRenderContext)
     mpConemapPostprocess = ComputeProgramWrapper::create(getDevice());
     mpConemapPostprocess->createProgram("Samples/Parallax/Conemap.cs.slang", "main_postprocess_max", {{kConeTypeDefine, mCMCompSettings.algorithm}});
 
-    mpTextureCopyCompute = ComputeProgramWrapper::create(getDevice());
-    mpTextureCopyCompute->createProgram( "Samples/Parallax/TextureCopy.cs.slang");
-
-    mpMinmaxCopyCompute = ComputeProgramWrapper::create(getDevice());
-    mpMinmaxCopyCompute->createProgram( "Samples/Parallax/Minmax.cs.slang", "copyFromScalarToVector");
-
-    mpMinmaxMipmapCompute = ComputeProgramWrapper::create(getDevice());
-    mpMinmaxMipmapCompute->createProgram( "Samples/Parallax/Minmax.cs.slang", "mipmapMinmax" );
+    mpHeightPyramidInitCompute = ComputeProgramWrapper::create(getDevice());
+    mpHeightPyramidInitCompute->createProgram("Samples/Parallax/HeightPyramid.cs.slang", "main_init");
+    mpHeightPyramidMipCompute = ComputeProgramWrapper::create(getDevice());
+    mpHeightPyramidMipCompute->createProgram("Samples/Parallax/HeightPyramid.cs.slang", "main_mip");
 
     mpQuickConemapCompute = ComputeProgramWrapper::create(getDevice());
     mpQuickConemapCompute->createProgram("Samples/Parallax/QuickConemap.cs.slang", "main", {
@@ -701,13 +833,6 @@ void Parallax::onLoad(RenderContext* pRenderContext)
         {kMaxAtTexelCenterDefine, mQCMCompSettings.maxAtTexelCenter ? "1" : "0"} }
     );
 
-    mpMaxCompute = ComputeProgramWrapper::create(getDevice());
-    mpMaxCompute->createProgram("Samples/Parallax/MaxMip2d.cs.slang", "main_calcMaxMip");
-    mpInitMaxMipCompute = ComputeProgramWrapper::create(getDevice());
-    mpInitMaxMipCompute->createProgram("Samples/Parallax/MaxMips.cs.slang", "main_initMaxMip");
-
-    mpCalcMaxMipCompute = ComputeProgramWrapper::create(getDevice());
-    mpCalcMaxMipCompute->createProgram("Samples/Parallax/MaxMips.cs.slang", "main_calcMaxMip");
     // geometry
     initSquare(getDevice(), mpVertexBuffer, mpVao);
 
@@ -747,7 +872,6 @@ void Parallax::onLoad(RenderContext* pRenderContext)
     //mRunHeightmapCompute = true;
 
     // generate a conemap in the first frame
-    mRunMinmaxCompute = true;
     mRunQuickConemapCompute = true;
     mQCMCompSettings.algorithm = "2";
     mQCMCompSettings.maxAtTexelCenter = false;
@@ -772,6 +896,14 @@ void Parallax::onFrameRender(RenderContext* pRenderContext, const ref<Fbo>& pTar
             pCopiedTexture->captureToFile(0, 0, saveFilePath, Bitmap::FileFormat::ExrFile);
         }
     }
+    if (doSaveTexture == 3) {
+        doSaveTexture = 0;
+        renderFrameOnCpu(pTargetFbo->getWidth(), pTargetFbo->getHeight(), pRenderContext);
+    }
+    if (doSaveTexture == 5) {
+        doSaveTexture = 0;
+        recordRaysOnCpu(pTargetFbo->getWidth(), pTargetFbo->getHeight());
+    }
     // procedural heightmap generation
     if (mRunHeightmapCompute) {
         mRunHeightmapCompute = false;
@@ -789,39 +921,71 @@ void Parallax::onFrameRender(RenderContext* pRenderContext, const ref<Fbo>& pTar
         mpConeTex = generateConemap(mCMCompSettings, mpHeightmapTex, pRenderContext);
         pParallaxVars["gTexture"] = mpConeTex;
         mpParallaxProgram->addDefine("DO_SQRT_LOOKUP", mCMCompSettings.DO_SQRT_LOOKUP ? "1" : "0");
-    }
-    // minmax mipmap for quick conemap generation
-    if ( mRunMinmaxCompute )
-    {
-        mRunMinmaxCompute = false;
-        ScopedProfilerEvent pe(pRenderContext, "compute_MinMaxMip");
-        mpMinmaxTex = generateMinmaxMipmap(mpHeightmapTex, pRenderContext);
+        // relaxed cones let the light through the walls; the shadows keep the last unrelaxed map
+        // unless it stores sqrt(tan) and the define no longer squares it
+        if (mCMCompSettings.algorithm == "1")
+        {
+            mpShadowConeTex = mpConeTex;
+            mShadowConeSqrt = mCMCompSettings.DO_SQRT_LOOKUP;
+        }
+        else if (mShadowConeSqrt && !mCMCompSettings.DO_SQRT_LOOKUP)
+            mpShadowConeTex.reset();
     }
     // quick conemap generation
     if (mRunQuickConemapCompute) {
         mRunQuickConemapCompute = false;
         ScopedProfilerEvent pe(pRenderContext, "compute_QuickConemap");
-        mpConeTex = generateQuickConemap(mQCMCompSettings, mpMinmaxTex, pRenderContext);
+        if (mQCMCompSettings.useCpu)
+            mpConeTex = generateQuickConemapCpu(mQCMCompSettings, mpHeightmapTex, pRenderContext);
+        else
+            mpConeTex = generateQuickConemap(mQCMCompSettings, getHeightPyramid(pRenderContext), pRenderContext);
         pParallaxVars["gTexture"] = mpConeTex;
+        // the center heuristic is not conservative
+        if (!mQCMCompSettings.maxAtTexelCenter)
+        {
+            mpShadowConeTex = mpConeTex;
+            mShadowConeSqrt = false;
+        }
+    }
+    if (mRenderSettings.selectedShadowFun >= 2)
+    {
+        if (!mpShadowConeTex && mpHeightmapTex)
+        {
+            ScopedProfilerEvent pe(pRenderContext, "compute_ShadowConemap");
+            QuickConemapComputeSettings shadowSettings;
+            shadowSettings.name = "Shadow Quick Conemap";
+            mpShadowConeTex = generateQuickConemap(shadowSettings, getHeightPyramid(pRenderContext), pRenderContext);
+            mShadowConeSqrt = false;
+        }
+        if (mpShadowConeTex)
+            pParallaxVars["ShadowConeTexture"] = mpShadowConeTex;
+        else
+        {
+            logWarning("SHADOW_FUN {} needs a cone map, falling back to the linear search", mRenderSettings.selectedShadowFun);
+            mRenderSettings.selectedShadowFun = 1;
+            mRenderSettings.setShadowFun();
+        }
+    }
+    if (mRenderSettings.selectedParallaxFun == 12 && !mHeightPyramidWithBorder)
+    {
+        logWarning("PARALLAX_FUN 12 needs the border channel of the height pyramid, rebuilding it");
+        mHeightPyramidWithBorder = true;
+        resetHeightPyramid();
     }
     if (mRunQDMCompute)
     {
         mRunQDMCompute = false;
-        ScopedProfilerEvent pe(pRenderContext, "compute_QDM");
-        mpQDMTex = generateQDMMap(mpHeightmapTex, pRenderContext);
-        if (mpQDMTex)
+        if (const auto& pPyramid = getHeightPyramid(pRenderContext))
         {
-            pParallaxVars["gTexture"] = mpQDMTex;
+            pParallaxVars["gTexture"] = pPyramid;
         }
     }
     if (mRunMaxMipCompute)
     {
         mRunMaxMipCompute = false;
-        ScopedProfilerEvent pe(pRenderContext, "compute_MaxMip");
-        mpMaxMipTex = generateMaxMipMap(mpHeightmapTex, pRenderContext);
-        if (mpMaxMipTex)
+        if (const auto& pPyramid = getHeightPyramid(pRenderContext))
         {
-            pParallaxVars["MaxMipTexture"] = mpMaxMipTex; // WARNING: Different texture
+            pParallaxVars["MaxMipTexture"] = pPyramid; // WARNING: Different texture
         }
     }
 
@@ -851,24 +1015,52 @@ void Parallax::onFrameRender(RenderContext* pRenderContext, const ref<Fbo>& pTar
         pParallaxVars[ "FScb" ][ "lightIntensity" ] = mRenderSettings.lightIntensity;
         pParallaxVars[ "FScb" ][ "steps" ] = mRenderSettings.stepNum;
         pParallaxVars[ "FScb" ][ "refine_steps" ] = mRenderSettings.refineStepNum;
+        pParallaxVars[ "FScb" ][ "refineEpsilon" ] = mRenderSettings.refineEpsilon;
         pParallaxVars[ "FScb" ][ "relax" ] = mRenderSettings.relax;
         pParallaxVars[ "FScb" ][ "oneOverSteps" ] = 1.0f / mRenderSettings.stepNum;
+        pParallaxVars[ "FScb" ][ "hybridMinStep" ] = mRenderSettings.hybridMinStep;
+        pParallaxVars[ "FScb" ][ "hybridConeSteps" ] = mRenderSettings.hybridConeSteps;
+        pParallaxVars[ "FScb" ][ "adaptiveStepsPerTexel" ] = mRenderSettings.adaptiveStepsPerTexel;
+        pParallaxVars[ "FScb" ][ "shadowSoftness" ] = mRenderSettings.shadowSoftness;
+        pParallaxVars[ "FScb" ][ "proceduralFun" ] = mProcHMCompSettings.heightFun;
+        pParallaxVars[ "FScb" ][ "proceduralSize" ] = mProcHMCompSettings.newHMapSize;
+        pParallaxVars[ "FScb" ][ "proceduralIntParams" ] = mProcHMCompSettings.HMapIntParams;
+        pParallaxVars[ "FScb" ][ "proceduralFloatParams" ] = mProcHMCompSettings.HMapFloatParams;
         pParallaxVars[ "FScb" ][ "const_isolate" ] = 1;
 
-        if (mRenderSettings.selectedParallaxFun == 10 && mpMaxMipTex)
-            pParallaxVars["FScb"]["HMMaxMip"] = mpMaxMipTex->getDepth() - 1; // WARNING: Slides play the role of mips
-        if (mRenderSettings.selectedParallaxFun == 11 && mpQDMTex)
-            pParallaxVars["FScb"]["HMMaxMip"] = mpQDMTex->getMipCount() - 1;
+        if ((mRenderSettings.selectedParallaxFun == 10 || mRenderSettings.selectedParallaxFun == 13) && mpHeightPyramidTex)
+            pParallaxVars["FScb"]["HMMaxMip"] = mpHeightPyramidTex->getMipCount(); // level 0 is the heightmap
+        if ((mRenderSettings.selectedParallaxFun == 11 || mRenderSettings.selectedParallaxFun == 12) && mpHeightPyramidTex)
+            pParallaxVars["FScb"]["HMMaxMip"] = virtualQuadtreeLevels(mpHeightPyramidTex.get()); // the root level of the quadtree
 
         pParallaxVars[ "VScb" ][ "viewProj" ] = mpCamera->getViewProjMatrix();
 
         pParallaxVars[ "VScb" ][ "model" ] = m;
         pParallaxVars[ "VScb" ][ "modelIT" ] = inverse(transpose(m));
 
+        if (mTraceStats.enabled)
+        {
+            if (!mpTraceStatsTex || mpTraceStatsTex->getWidth() != pTargetFbo->getWidth() || mpTraceStatsTex->getHeight() != pTargetFbo->getHeight())
+            {
+                mpTraceStatsTex = getDevice()->createTexture2D(pTargetFbo->getWidth(), pTargetFbo->getHeight(), ResourceFormat::RGBA32Uint, 1, 1, nullptr,
+                                                               ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
+                mpTraceStatsTex->setName("Trace statistics");
+            }
+            pRenderContext->clearUAV(mpTraceStatsTex->getUAV().get(), uint4(0));
+            pParallaxVars["gTraceStats"] = mpTraceStatsTex;
+        }
+
         mPixelDebug.beginFrame(pRenderContext, uint2(pTargetFbo->getWidth(), pTargetFbo->getHeight()));
         mPixelDebug.prepareProgram(mpParallaxProgram, pParallaxVars);
         pRenderContext->draw( mpParallaxRenderState.get(), mpParallaxVars.get(), kVertices.size(), 0 );
         mPixelDebug.endFrame(pRenderContext);
+
+        if (mTraceStats.enabled && (mTraceStats.logNextFrame || doSaveTexture == 4))
+        {
+            reportTraceStats(doSaveTexture == 4 ? saveFilePath : std::filesystem::path(), pRenderContext);
+            mTraceStats.logNextFrame = false;
+            doSaveTexture = doSaveTexture == 4 ? 0 : doSaveTexture;
+        }
     }
     else
     {
@@ -989,9 +1181,8 @@ void Parallax::LoadHeightmapTexture()
     }
     mpHeightmapTex->setName(filenameFromPath(mHeightmapName.string()));
     mpConeTex.reset();
-    mpMinmaxTex.reset();
-    mpQDMTex.reset();
-    mpMaxMipTex.reset();
+    mpShadowConeTex.reset();
+    mpHeightPyramidTex.reset();
     ShaderVar pParallaxVars = mpParallaxVars->getRootVar();
     pParallaxVars["gTexture"] = mpHeightmapTex;
     float2 res = float2(mpHeightmapTex->getWidth(), mpHeightmapTex->getHeight());
@@ -1087,88 +1278,233 @@ ref<Texture> Parallax::generateConemap(const ConemapComputeSettings& settings, c
     return pTex;
 }
 
-ref<Texture> Parallax::generateMinmaxMipmap(const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const
-{
-    // Initialize the minmax LOD 0
-    uint2 maxSize = { pHeightmap->getWidth(), pHeightmap->getHeight() };
-    auto pTex = getDevice()->createTexture2D(maxSize.x, maxSize.y, ResourceFormat::RG16Unorm, 1, uint32_t(-1), nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
-
-    auto& copyCS = *mpMinmaxCopyCompute;
-    copyCS["CScb"]["maxSize"] = maxSize;
-    copyCS["heightMap"].setSrv(pHeightmap->getSRV(0));
-    copyCS["dstMinmaxMap"].setUav(pTex->getUAV(0));
-    copyCS.runProgram(maxSize.x, maxSize.y, 1);
-
-    // And do the minmax pooled mipmapping for all remaining LODs
-    auto& minmaxCS = *mpMinmaxMipmapCompute;
-    for (uint currentLevel = 0; currentLevel < pTex->getMipCount() - 1; ++currentLevel)
-    {
-        maxSize /= 2u;
-        minmaxCS["CScb"]["maxSize"] = maxSize;
-        minmaxCS["CScb"]["currentLevel"] = currentLevel;
-        minmaxCS["srcMinmaxMap"].setSrv(pTex->getSRV());
-        minmaxCS["dstMinmaxMap"].setUav(pTex->getUAV(currentLevel + 1));
-        minmaxCS.runProgram(maxSize.x, maxSize.y, 1);
-    }
-    return pTex;
-}
-
-
-
-ref<Texture> Parallax::generateQuickConemap(const QuickConemapComputeSettings& settings, const ref<Texture>& pMinmaxMipmap, RenderContext* pRenderContext) const
+ref<Texture> Parallax::generateQuickConemap(const QuickConemapComputeSettings& settings, const ref<Texture>& pHeightPyramid, RenderContext* pRenderContext) const
 {
-    if (!mpQuickConemapCompute || !pMinmaxMipmap)
+    if (!mpQuickConemapCompute || !pHeightPyramid)
         return nullptr;
     auto& comp = *mpQuickConemapCompute;
-    auto w = pMinmaxMipmap->getWidth();
-    auto h = pMinmaxMipmap->getHeight();
+    auto w = pHeightPyramid->getWidth();
+    auto h = pHeightPyramid->getHeight();
     ResourceFormat coneMapFormat = settings.newHmap16bit ? ResourceFormat::RG16Unorm : ResourceFormat::RG8Unorm;
     auto pTex = getDevice()->createTexture2D(w, h, coneMapFormat, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess);
     pTex->setName(settings.name);
     comp.getProgram()->addDefine(kQuickGenAlgDefine, settings.algorithm);
     comp.getProgram()->addDefine(kMaxAtTexelCenterDefine, settings.maxAtTexelCenter ? "1" : "0");
-    comp["srcMinmaxMap"].setSrv(pMinmaxMipmap->getSRV(0));
+    comp["srcHeightPyramid"].setSrv(pHeightPyramid->getSRV(0));
     comp["dstConeMap"].setUav(pTex->getUAV(0));
     uint2 maxSize = { w, h };
-    comp["CScb"]["maxLevel"] = pMinmaxMipmap->getMipCount() - 2u;
+    // the last level with more than one node on the virtual grid
+    comp["CScb"]["maxLevel"] = std::max(1u, virtualQuadtreeLevels(pHeightPyramid.get())) - 1u;
     comp["CScb"]["maxSize"] = maxSize;
     comp["CScb"]["deltaHalf"] = 0.5f / float2(maxSize);
     comp.runProgram(w, h, 1);
 
-    
-    if (settings.POSTPROCESS_MIN)
-    {
-        auto pTex2 = getDevice()->createTexture2D(
-            w, h, coneMapFormat, 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess
-        );
-        pTex2->setName(settings.name);
-        auto& comp2 = *mpConemapPostprocess;
-        comp2.getProgram()->addDefine(kConeTypeDefine, settings.algorithm);
-        comp2["coneMap_in"].setSrv(pTex->getSRV());
-        comp2["CScb"]["srcLevel"] = 0;
-        comp2["coneMap"].setUav(pTex2->getUAV(0));
-        comp2["CScb"]["maxSize"] = maxSize;
-        // the rest of the settings are unused
-        comp2["gSampler"] = mpSampler;
-        comp2["CScb"]["oneOverMaxSize"] = 1.0f / float2(maxSize);
-        comp2["CScb"]["searchSteps"] = 2; 
-        comp2["CScb"]["oneOverSearchSteps"] = 0.5f;
-        comp2["CScb"]["bitCount"] = settings.newHmap16bit ? 65535 : 255;
-
-        comp2.runProgram(w, h, 1);
+    return postprocessQuickConemap(settings, pTex, pRenderContext);
+}
+ref<Texture> Parallax::postprocessQuickConemap(const QuickConemapComputeSettings& settings, const ref<Texture>& pConemap, RenderContext* pRenderContext) const
+{
+    if (!settings.POSTPROCESS_MIN || !pConemap)
+        return pConemap;
+    auto w = pConemap->getWidth();
+    auto h = pConemap->getHeight();
+    uint2 maxSize = { w, h };
+    auto pTex2 = getDevice()->createTexture2D(
+        w, h, pConemap->getFormat(), 1, 1, nullptr, ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess
+    );
+    pTex2->setName(settings.name);
+    auto& comp2 = *mpConemapPostprocess;
+    comp2.getProgram()->addDefine(kConeTypeDefine, settings.algorithm);
+    comp2["coneMap_in"].setSrv(pConemap->getSRV());
+    comp2["CScb"]["srcLevel"] = 0;
+    comp2["coneMap"].setUav(pTex2->getUAV(0));
+    comp2["CScb"]["maxSize"] = maxSize;
+    // the rest of the settings are unused
+    comp2["gSampler"] = mpSampler;
+    comp2["CScb"]["oneOverMaxSize"] = 1.0f / float2(maxSize);
+    comp2["CScb"]["searchSteps"] = 2; 
+    comp2["CScb"]["oneOverSearchSteps"] = 0.5f;
+    comp2["CScb"]["bitCount"] = settings.newHmap16bit ? 65535 : 255;
+
+    comp2.runProgram(w, h, 1);
+
+    return pTex2;
+}
+ParallaxCpu::HeightImage Parallax::readHeightmapToCpu(const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const
+{
+    ParallaxCpu::HeightImage heightmap;
+    if (!pHeightmap)
+        return heightmap;
+    const ResourceFormat format = pHeightmap->getFormat();
+    const uint32_t texelBytes = getFormatBytesPerBlock(format);
+    const uint32_t redBits = getNumChannelBits(format, 0);
+    const bool isFloat = getFormatType(format) == FormatType::Float;
+    const bool isBGR = format == ResourceFormat::BGRA8Unorm || format == ResourceFormat::BGRA8UnormSrgb ||
+                       format == ResourceFormat::BGRX8Unorm || format == ResourceFormat::BGRX8UnormSrgb;
+    FALCOR_CHECK(
+        (!isFloat && (redBits == 8 || redBits == 16)) || (isFloat && redBits == 32),
+        "Unsupported heightmap format for the CPU path: {}", to_string(format)
+    );
 
-        pTex = pTex2;
+    // the height is in the red channel
+    const std::vector<uint8_t> data = pRenderContext->readTextureSubresource(pHeightmap.get(), 0);
+    const uint32_t redOffset = isBGR ? 2 : 0;
+    heightmap = ParallaxCpu::HeightImage(pHeightmap->getWidth(), pHeightmap->getHeight());
+    for (size_t i = 0; i < heightmap.texels.size(); ++i)
+    {
+        const uint8_t* pTexel = data.data() + i * texelBytes + redOffset;
+        if (isFloat)
+        {
+            float h;
+            std::memcpy(&h, pTexel, sizeof(float));
+            heightmap.texels[i] = uint16_t(std::clamp(h, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        }
+        else if (redBits == 16)
+            std::memcpy(&heightmap.texels[i], pTexel, sizeof(uint16_t));
+        else
+            heightmap.texels[i] = uint16_t(*pTexel) * 257;
+    }
+    return heightmap;
+}
+ParallaxCpu::CameraSettings Parallax::getCpuCamera() const
+{
+    ParallaxCpu::CameraSettings camera;
+    const float3 position = mpCamera->getPosition(), target = mpCamera->getTarget(), up = mpCamera->getUpVector();
+    camera.position = { position.x, position.y, position.z };
+    camera.target = { target.x, target.y, target.z };
+    camera.up = { up.x, up.y, up.z };
+    camera.fovY = focalLengthToFovY(mpCamera->getFocalLength(), mpCamera->getFrameHeight());
+    return camera;
+}
+void Parallax::renderFrameOnCpu(uint32_t width, uint32_t height, RenderContext* pRenderContext) const
+{
+    const ParallaxCpu::HeightImage heightmap = readHeightmapToCpu(mpHeightmapTex, pRenderContext);
+    if (heightmap.empty())
+        return;
+    const ParallaxCpu::CameraSettings camera = getCpuCamera();
+
+    const auto start = CpuTimer::getCurrentTimePoint();
+    ParallaxCpu::Renderer renderer(heightmap);
+    ParallaxCpu::ProceduralHeightSettings procedural;
+    procedural.heightFun = mProcHMCompSettings.heightFun;
+    procedural.width = mProcHMCompSettings.newHMapSize.x;
+    procedural.height = mProcHMCompSettings.newHMapSize.y;
+    for (int i = 0; i < 4; ++i)
+    {
+        procedural.intParams[i] = mProcHMCompSettings.HMapIntParams[i];
+        procedural.floatParams[i] = mProcHMCompSettings.HMapFloatParams[i];
+    }
+    renderer.setProceduralHeight(procedural);
+    const auto frame = renderer.render(ParallaxCpu::RenderSettings(mRenderSettings), camera, width, height);
+    logInfo("CPU frame: {}x{} in {:.1f} ms on {} threads", width, height, CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()), ParallaxCpu::getWorkerCount());
+    if (!ParallaxCpu::writePng(saveFilePath.string(), frame))
+        logWarning("Can't write {}", saveFilePath.string());
+}
+void Parallax::recordRaysOnCpu(uint32_t width, uint32_t height) const
+{
+    ParallaxCpu::RaySet set;
+    set.heightmapWidth = mpHeightmapTex->getWidth();
+    set.heightmapHeight = mpHeightmapTex->getHeight();
+    set.views.push_back(ParallaxCpu::castRays(ParallaxCpu::RenderSettings(mRenderSettings), getCpuCamera(), width, height));
+    if (ParallaxCpu::writeRaySet(saveFilePath.string(), set))
+        logInfo("Recorded {} rays of a {}x{} frame to {}", set.getRayCount(), width, height, saveFilePath.string());
+    else
+        logWarning("Can't write {}", saveFilePath.string());
+}
+ParallaxCpu::StatsImage Parallax::readTraceStats(RenderContext* pRenderContext) const
+{
+    ParallaxCpu::StatsImage stats;
+    if (!mpTraceStatsTex)
+        return stats;
+    static_assert(sizeof(ParallaxCpu::PixelStats) == 4 * sizeof(uint32_t), "PixelStats must match the RGBA32Uint texels");
+    const std::vector<uint8_t> data = pRenderContext->readTextureSubresource(mpTraceStatsTex.get(), 0);
+    stats = ParallaxCpu::StatsImage(mpTraceStatsTex->getWidth(), mpTraceStatsTex->getHeight());
+    std::memcpy(stats.texels.data(), data.data(), std::min(data.size(), stats.texels.size() * sizeof(ParallaxCpu::PixelStats)));
+    return stats;
+}
+void Parallax::reportTraceStats(const std::filesystem::path& heatmapPath, RenderContext* pRenderContext) const
+{
+    const ParallaxCpu::StatsImage stats = readTraceStats(pRenderContext);
+    const ParallaxCpu::TraceStatsSummary summary = ParallaxCpu::summarizeTraceStats(stats);
+    logInfo("Trace statistics of PARALLAX_FUN {}, REFINE_FUN {}: {}", mRenderSettings.selectedParallaxFun, mRenderSettings.selectedRefinementFun,
+            ParallaxCpu::toString(summary));
+    if (heatmapPath.empty())
+        return;
+    for (ParallaxCpu::TraceCounter counter : {ParallaxCpu::TraceCounter::Steps, ParallaxCpu::TraceCounter::Fetches})
+    {
+        const float scale = mTraceStats.heatmapScale > 0 ? mTraceStats.heatmapScale : float(summary[counter].p99);
+        std::filesystem::path path = heatmapPath;
+        path.replace_filename(heatmapPath.stem().string() + (counter == ParallaxCpu::TraceCounter::Steps ? "_steps.png" : "_fetches.png"));
+        if (!ParallaxCpu::writePng(path.string(), ParallaxCpu::makeHeatmap(stats, counter, scale)))
+            logWarning("Can't write {}", path.string());
     }
+}
+ref<Texture> Parallax::createConemapTexture(const ParallaxCpu::ConeImage& coneMap, bool is16bit, const std::string& name) const
+{
+    // heights are rounded, cones truncated so that we don't round up to incorrectly large cones
+    const float bitCount = is16bit ? 65535.0f : 255.0f;
+    const auto toUnorm = [bitCount](float v, float rounding) { return uint32_t(std::clamp(v, 0.0f, 1.0f) * bitCount + rounding); };
+    std::vector<uint16_t> data16;
+    std::vector<uint8_t> data8;
+    if (is16bit)
+        data16.reserve(coneMap.texels.size() * 2);
+    else
+        data8.reserve(coneMap.texels.size() * 2);
+    for (const ParallaxCpu::float2& t : coneMap.texels)
+    {
+        if (is16bit)
+        {
+            data16.push_back(uint16_t(toUnorm(t.x, 0.5f)));
+            data16.push_back(uint16_t(toUnorm(t.y, 0.0f)));
+        }
+        else
+        {
+            data8.push_back(uint8_t(toUnorm(t.x, 0.5f)));
+            data8.push_back(uint8_t(toUnorm(t.y, 0.0f)));
+        }
+    }
+    auto pTex = getDevice()->createTexture2D(
+        coneMap.width, coneMap.height, is16bit ? ResourceFormat::RG16Unorm : ResourceFormat::RG8Unorm, 1, 1,
+        is16bit ? (const void*)data16.data() : (const void*)data8.data(),
+        ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess
+    );
+    pTex->setName(name);
     return pTex;
 }
-ref<Texture> Parallax::generateQDMMap(const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const
+ref<Texture> Parallax::generateQuickConemapCpu(const QuickConemapComputeSettings& settings, const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const
+{
+    if (!pHeightmap)
+        return nullptr;
+    const ParallaxCpu::HeightImage heightmap = readHeightmapToCpu(pHeightmap, pRenderContext);
+
+    const auto start = CpuTimer::getCurrentTimePoint();
+    ParallaxCpu::HybridConemapSettings cpuSettings;
+    cpuSettings.quick.algorithm = ParallaxCpu::QuickConemapAlgorithm(std::stoul(settings.algorithm));
+    cpuSettings.quick.maxAtTexelCenter = settings.maxAtTexelCenter;
+    cpuSettings.texelFraction = settings.exactTexelPercent / 100.0f;
+    cpuSettings.timeBudgetMs = settings.exactTimeBudgetMs;
+    uint32_t refinedTexelCount = 0;
+    const ParallaxCpu::ConeImage coneMap = cpuSettings.texelFraction > 0
+        ? ParallaxCpu::generateHybridConemap(cpuSettings, heightmap, &refinedTexelCount)
+        : ParallaxCpu::generateQuickConemap(cpuSettings.quick, heightmap);
+    logInfo("{}: {:.1f} ms on {} threads, {} texels refined exactly", settings.name, CpuTimer::calcDuration(start, CpuTimer::getCurrentTimePoint()), ParallaxCpu::getWorkerCount(), refinedTexelCount);
+
+    auto pTex = createConemapTexture(coneMap, settings.newHmap16bit, settings.name);
+    return postprocessQuickConemap(settings, pTex, pRenderContext);
+}
+ref<Texture> Parallax::generateHeightPyramid(const ref<Texture>& pHeightmap, bool withMin, bool withBorder, RenderContext* pRenderContext) const
 {
-    if (!mpTextureCopyCompute || !mpMaxCompute || !pHeightmap)
+    if (!mpHeightPyramidInitCompute || !mpHeightPyramidMipCompute || !pHeightmap)
         return nullptr;
     auto w = pHeightmap->getWidth();
     auto h = pHeightmap->getHeight();
-    auto format = Falcor::getNumChannelBits(pHeightmap->getFormat(), 0) == 8 ? ResourceFormat::R8Unorm : ResourceFormat::R16Unorm;
-    auto pQDMTex = getDevice()->createTexture2D(
+    const bool is8bit = Falcor::getNumChannelBits(pHeightmap->getFormat(), 0) == 8;
+    ResourceFormat format;
+    if (withMin || withBorder)
+        format = is8bit ? ResourceFormat::RGBA8Unorm : ResourceFormat::RGBA16Unorm;
+    else
+        format = is8bit ? ResourceFormat::RG8Unorm : ResourceFormat::RG16Unorm;
+    // Mip 0 is at the size of the heightmap, see HeightPyramid.cs.slang for the channels
+    auto pTex = getDevice()->createTexture2D(
         w,
         h,
         format,
@@ -1177,78 +1513,48 @@ ref<Texture> Parallax::generateQDMMap(const ref<Texture>& pHeightmap, RenderCont
         nullptr,
         ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess
     );
+    pTex->setName("Height Pyramid");
 
-    pQDMTex->setName("QDM Max Mipmaped");
-
-    // Initialize the MIP 0 with the heightmap
-    auto& copy = *mpTextureCopyCompute;
-    copy.getProgram()->addDefine("ASSIGN", "DST.x = SRC.x;");
     uint2 texSize = uint2(w, h);
-    copy["CScb"]["maxSize"] = texSize;
-    copy["src"].setSrv(pHeightmap->getSRV(0));
-    copy["dst"].setUav(pQDMTex->getUAV(0));
-    copy.runProgram( texSize.x, texSize.y);
-
-    auto& prog = *mpMaxCompute;
+    auto& init = *mpHeightPyramidInitCompute;
+    init.getProgram()->addDefine("PYRAMID_BORDER", withBorder ? "1" : "0");
+    init["CScb"]["inputSize"] = texSize;
+    init["CScb"]["outputSize"] = texSize;
+    init["heightMap"].setSrv(pHeightmap->getSRV(0));
+    init["dstPyramid"].setUav(pTex->getUAV(0));
+    init.runProgram(texSize.x, texSize.y);
 
-    for (uint currentLevel = 0; currentLevel < pQDMTex->getMipCount() - 1; ++currentLevel)
+    auto& mip = *mpHeightPyramidMipCompute;
+    mip.getProgram()->addDefine("PYRAMID_MIN", withMin ? "1" : "0");
+    mip.getProgram()->addDefine("PYRAMID_BORDER", withBorder ? "1" : "0");
+    for (uint level = 1; level < pTex->getMipCount(); ++level)
     {
-        prog["CScb"]["inputSize"] = texSize;
+        mip["CScb"]["inputSize"] = texSize;
         texSize = max(uint2(1u), texSize / 2u);
-        prog["CScb"]["outputSize"] = texSize;
-        prog["inputTexture"].setSrv(pQDMTex->getSRV(currentLevel));
-        prog["outputTexture"].setUav(pQDMTex->getUAV(currentLevel + 1));
-        prog.runProgram( texSize.x, texSize.y);
+        mip["CScb"]["outputSize"] = texSize;
+        mip["srcPyramid"].setSrv(pTex->getSRV(level - 1, 1));
+        mip["dstPyramid"].setUav(pTex->getUAV(level));
+        mip.runProgram(texSize.x, texSize.y);
     }
-    return pQDMTex;
+    return pTex;
 }
-ref<Texture> Parallax::generateMaxMipMap(const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const
+const ref<Texture>& Parallax::getHeightPyramid(RenderContext* pRenderContext)
 {
-
-    if ( !mpInitMaxMipCompute || !pHeightmap) return nullptr;
-
-    auto w = pHeightmap->getWidth();
-    auto h = pHeightmap->getHeight();
-    uint32_t d = static_cast<uint32_t>(Falcor::math::log2<float>(w)) + 2;
-    auto format = Falcor::getNumChannelBits(pHeightmap->getFormat(), 0) == 8 ? ResourceFormat::R8Unorm : ResourceFormat::R16Unorm;
-    auto pMaxMipTex = getDevice()->createTexture3D(
-        w,
-        h,
-        d,
-        format,
-        1,
-        nullptr,
-        ResourceBindFlags::ShaderResource | ResourceBindFlags::UnorderedAccess
-    );
-
-    pMaxMipTex->setName("Max Mipmaped");
-
-    
-    uint2 texSize = uint2(w, h);
-
-    auto& init = *mpInitMaxMipCompute;
-
-    init["CScb"]["inputSize"] = texSize;
-    init["CScb"]["outputSize"] = texSize;
-    init["inputTexture"].setSrv(pHeightmap->getSRV(0));
-    init["outputTexture"].setUav(pMaxMipTex->getUAV(0));
-
-    init.runProgram(texSize.x, texSize.y);
-
-    auto& calc = *mpCalcMaxMipCompute;
-    for (uint l = 2; l < d; ++l)
+    if (!mpHeightPyramidTex)
     {
-        texSize.x >>= 1;
-        texSize.y >>= 1;
-
-        calc["CScb"]["outputSize"] = texSize;
-        calc["CScb"]["outputLevel"] = l;
-        calc["outputTexture"].setUav(pMaxMipTex->getUAV(0));
-        calc.runProgram(texSize.x, texSize.y);
+        ScopedProfilerEvent pe(pRenderContext, "compute_HeightPyramid");
+        mpHeightPyramidTex = generateHeightPyramid(mpHeightmapTex, mHeightPyramidWithMin, mHeightPyramidWithBorder, pRenderContext);
     }
-
-
-    return pMaxMipTex;
+    return mpHeightPyramidTex;
+}
+void Parallax::resetHeightPyramid()
+{
+    mpHeightPyramidTex.reset();
+    // the tracers bind it only when it is generated
+    if (mRenderSettings.selectedParallaxFun == 11 || mRenderSettings.selectedParallaxFun == 12)
+        mRunQDMCompute = true;
+    else if (mRenderSettings.selectedParallaxFun == 10 || mRenderSettings.selectedParallaxFun == 13)
+        mRunMaxMipCompute = true;
 }
 
 
@@ -1277,14 +1583,39 @@ std::string Parallax::getModelAndSettingsString()
         if (mRenderSettings.CONSERVATIVE_STEP)
             ss << "-conservative";
     }
+    else if (mRenderSettings.selectedParallaxFun == 13)
+    {
+        if (!mpConeTex)
+            return "noConeMap";
+        ss << mpConeTex->getName()
+           << "_res-" << mpConeTex->getWidth()
+           << "_primary-conestep-maxmip-" << mRenderSettings.stepNum
+           << "-switch-" << mRenderSettings.hybridMinStep << "-" << mRenderSettings.hybridConeSteps;
+    }
+    else if (mRenderSettings.selectedParallaxFun == 14)
+    {
+        ss << "Procedural-" << kHeightFunList[mProcHMCompSettings.heightFun].label
+           << "_res-" << mProcHMCompSettings.newHMapSize.x
+           << "_primary-lipschitz-" << mRenderSettings.stepNum;
+    }
 
     ss << "_refine-"
        << (mRenderSettings.selectedRefinementFun == 0   ? "none"
            : mRenderSettings.selectedRefinementFun == 1 ? "linear"
+           : mRenderSettings.selectedRefinementFun == 3 ? "secant"
+           : mRenderSettings.selectedRefinementFun == 4 ? "patch"
                                                         : "binary-");
     if (mRenderSettings.selectedParallaxFun == 2)
         ss << mRenderSettings.refineStepNum;
-
+    if (mRenderSettings.selectedRefinementFun == 3)
+        ss << "_epsilon-" << mRenderSettings.refineEpsilon;
+
+    if (mRenderSettings.ADAPTIVE_STEPS)
+        ss << "_adaptive-" << mRenderSettings.adaptiveStepsPerTexel;
+    if (mRenderSettings.selectedShadowFun != 0)
+        ss << "_shadow-" << (mRenderSettings.selectedShadowFun == 1 ? "linear" : "cone");
+    if (mRenderSettings.selectedShadowFun == 3)
+        ss << "-soft-" << mRenderSettings.shadowSoftness;
     if (!mRenderSettings.displayNonConverged)
         ss << "_hide-unconverged";
 
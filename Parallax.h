@@ -30,6 +30,10 @@
 #include "Core/SampleApp.h"
 #include "ComputeProgramWrapper.h"
 #include "ParallaxPixelDebug/ParallaxPixelDebug.h"
+#include "ParallaxCpu/QuickConemap.h"
+#include "ParallaxCpu/HybridConemap.h"
+#include "ParallaxCpu/RenderSettings.h"
+#include "ParallaxCpu/TraceStats.h"
 
 using namespace Falcor;
 
@@ -91,18 +95,15 @@ private:
         std::string name = "";
     } mCMCompSettings;
 
-    ref<ComputeProgramWrapper> mpTextureCopyCompute = nullptr;
-
-    ref<ComputeProgramWrapper> mpMinmaxCopyCompute = nullptr;
-    ref<ComputeProgramWrapper> mpMinmaxMipmapCompute = nullptr;
-    bool mRunMinmaxCompute = false;
-
     ref<ComputeProgramWrapper> mpQuickConemapCompute = nullptr;
     bool mRunQuickConemapCompute = false;
     struct QuickConemapComputeSettings {
         bool newHmap16bit = true;
         bool POSTPROCESS_MIN = false;
         bool maxAtTexelCenter = false;
+        bool useCpu = false;
+        float exactTexelPercent = 0.0f;  // CPU only: share of texels refined with the exact falling edge cone
+        float exactTimeBudgetMs = 0.0f;  // CPU only: time limit of the bake with the refinement, 0: no limit
         std::string algorithm = "2";
         std::string name = "";
     } mQCMCompSettings;
@@ -125,20 +126,24 @@ private:
     ref<Sampler> mpSampler = nullptr;
     ref<Sampler> mpSamplerNearest = nullptr;
     ref<Texture> mpConeTex = nullptr;
-    ref<Texture> mpMinmaxTex = nullptr;
-
-    ref<ComputeProgramWrapper> mpMaxCompute = nullptr;
+    // the unrelaxed cones of SHADOW_FUN 2 and 3: the last of Dummer's or the quick conemaps, else a quick conemap baked for them
+    ref<Texture> mpShadowConeTex = nullptr;
+    bool mShadowConeSqrt = false; // mpShadowConeTex stores sqrt(tan), see DO_SQRT_LOOKUP
+
+    // one pyramid for QDM, Maximum Mip and the GPU quick conemap, see HeightPyramid.cs.slang
+    ref<ComputeProgramWrapper> mpHeightPyramidInitCompute = nullptr;
+    ref<ComputeProgramWrapper> mpHeightPyramidMipCompute = nullptr;
+    ref<Texture> mpHeightPyramidTex = nullptr; // reset when the heightmap changes
+    bool mHeightPyramidWithMin = false;
+    bool mHeightPyramidWithBorder = false; // for the bilinear QDM (PARALLAX_FUN 12)
+    ref<Texture> generateHeightPyramid(const ref<Texture>& pHeightmap, bool withMin, bool withBorder, RenderContext* pRenderContext) const;
+    const ref<Texture>& getHeightPyramid(RenderContext* pRenderContext); // generates it on first use
+    void resetHeightPyramid(); // drops the pyramid and rebinds the next one for the selected PARALLAX_FUN
 
     bool mRunQDMCompute = false;
-    ref<Texture> mpQDMTex = nullptr;
-    ref<Texture> generateQDMMap(const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const;
     void Parallax::guiQDMGeneration(Gui::Widgets& parent);
 
-    ref<ComputeProgramWrapper> mpInitMaxMipCompute = nullptr;
-    ref<ComputeProgramWrapper> mpCalcMaxMipCompute = nullptr;
     bool mRunMaxMipCompute = false;
-    ref<Texture> mpMaxMipTex = nullptr;
-    ref<Texture> generateMaxMipMap(const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const;
     void Parallax::guiMaxMipGeneration(Gui::Widgets& parent);
 
     std::filesystem::path saveFilePath = "";
@@ -154,35 +159,38 @@ private:
 
     // render settings
     friend struct RenderSettings;
-    struct RenderSettings {
+    struct RenderSettings : ParallaxCpu::RenderSettingsT<float3> {
         RenderSettings(Parallax& app) : app(app) {}
         Parallax& app;
-        float3 lightDir{ normalize(float3(.198f, -.462f, -.865f)) };
-        float heightMapHeight = 0.2f;
-        bool discardFragments = true;
-        bool displayNonConverged = true;
-        float lightIntensity = 1.0f;
-        uint stepNum = 200;
-        uint refineStepNum = 5;
-        float3 scale{ 1, 1, 1 };
-        float angle = 0.0f;
-        float3 axis{ 0, 0, 1 };
-        float3 translate{ 0, 0, 0 };
-        float relax = 1.0f;
-        bool BILINEAR_BY_HAND = false;
-        bool CONSERVATIVE_STEP = false;
-        uint32_t selectedParallaxFun = 3; // see kParallaxFunList
-        void setParallaxFun();
-        uint32_t selectedRefinementFun = 0; // see kRefineFunList
-        void setRefinementFun();
+        void setParallaxFun();   // selectedParallaxFun, see kParallaxFunList
+        void setRefinementFun(); // selectedRefinementFun, see kRefineFunList
+        void setShadowFun();     // selectedShadowFun, see kShadowFunList
     } mRenderSettings;
 
 
     // compute calls
     ref<Texture> generateProceduralHeightmap(const ProceduralHeightmapComputeSettings& settings, RenderContext* pRenderContext) const;
     ref<Texture> generateConemap(const ConemapComputeSettings& settings, const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const;
-    ref<Texture> generateMinmaxMipmap(const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const;
-    ref<Texture> generateQuickConemap(const QuickConemapComputeSettings& settings, const ref<Texture>& pMinmaxMipmap, RenderContext* pRenderContext) const;
+    ref<Texture> generateQuickConemap(const QuickConemapComputeSettings& settings, const ref<Texture>& pHeightPyramid, RenderContext* pRenderContext) const;
+    ref<Texture> postprocessQuickConemap(const QuickConemapComputeSettings& settings, const ref<Texture>& pConemap, RenderContext* pRenderContext) const;
+
+    // CPU paths
+    ParallaxCpu::HeightImage readHeightmapToCpu(const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const;
+    ref<Texture> createConemapTexture(const ParallaxCpu::ConeImage& coneMap, bool is16bit, const std::string& name) const;
+    ref<Texture> generateQuickConemapCpu(const QuickConemapComputeSettings& settings, const ref<Texture>& pHeightmap, RenderContext* pRenderContext) const;
+    ParallaxCpu::CameraSettings getCpuCamera() const;
+    void renderFrameOnCpu(uint32_t width, uint32_t height, RenderContext* pRenderContext) const; // to saveFilePath, see ParallaxCpu/Renderer.h
+    void recordRaysOnCpu(uint32_t width, uint32_t height) const; // to saveFilePath, see ParallaxCpu/RaySet.h
+
+    // TRACE_STATS: per pixel steps, refinement steps and fetches of the tracers, see ParallaxCpu/TraceStats.h
+    struct TraceStatsSettings {
+        bool enabled = false;
+        bool logNextFrame = false;
+        float heatmapScale = 0.0f; // 0: the p99 of the frame
+    } mTraceStats;
+    ref<Texture> mpTraceStatsTex = nullptr; // RGBA32Uint, the size of the frame
+    ParallaxCpu::StatsImage readTraceStats(RenderContext* pRenderContext) const;
+    void reportTraceStats(const std::filesystem::path& heatmapPath, RenderContext* pRenderContext) const; // heatmaps: empty path for log only
 
     // Pixeld Debug
     ParallaxPixelDebug mPixelDebug;
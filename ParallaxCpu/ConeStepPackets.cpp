@@ -0,0 +1,120 @@
+#include "ConeStepPackets.h"
+#include "Math.h"
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+
+// the scalar tracers use the baseline ConeStepState
+#define PARALLAX_CPU_SIMD_KERNELS "ConeStepPacketsSimd.inl"
+#include "SimdKernels.h"
+
+namespace ParallaxCpu
+{
+namespace
+{
+using portable::ConeStepState;
+using portable::sampleCone;
+} // namespace
+
+ConeStepHit traceConeStep(const ConeStepSettings& settings, const ConeTexture& coneMap, const ConeStepRay& ray, std::vector<float2>* pSamples,
+                          float startSc)
+{
+    ConeStepState s(coneMap, ray, startSc);
+    if (pSamples)
+        pSamples->push_back(s.u + float2{s.ds.x, s.ds.y} * s.sc);
+    const float2 HMres = {float(coneMap.width), float(coneMap.height)};
+    float w = 1 / HMres.x;
+    while (1.0f - s.ds.z * s.sc > s.t.x && s.stepCount < settings.stepNum)
+    {
+        s.zTimesSc = s.ds.z * s.sc;
+        if (settings.conservativeStep)
+        {
+            // step at least to the next texel wall along the ray
+            const float2 p = s.u + float2{s.ds.x, s.ds.y} * s.sc;
+            const float2 cellCenter = {(std::floor(p.x * HMres.x - .5f) + 1) / HMres.x, (std::floor(p.y * HMres.y - .5f) + 1) / HMres.y};
+            const float2 wall = cellCenter + s.dirSign;
+            w = std::min((wall.x - p.x) / s.ds.x, (wall.y - p.y) / s.ds.y) + 1e-5f;
+        }
+        s.sc += settings.relax * std::max(w, (1.0f - s.zTimesSc - s.t.x) * s.t.y / (s.t.y * s.ds.z + s.iz));
+        s.t = sampleCone(coneMap, s.u + float2{s.ds.x, s.ds.y} * s.sc);
+        if (pSamples)
+            pSamples->push_back(s.u + float2{s.ds.x, s.ds.y} * s.sc);
+        ++s.stepCount;
+    }
+    return s.hit(settings.stepNum);
+}
+
+void traceConeStepPackets(const ConeStepSettings& settings, const ConeTexture& coneMap, const ConeStepRay* rays, ConeStepHit* hits, size_t count,
+                          const float* pStartSc)
+{
+    PARALLAX_CPU_SIMD_CALL(traceConeStepPackets, settings, coneMap, rays, hits, count, pStartSc);
+}
+
+void traceConeStepBeams(const ConeTexture& coneMap, const ConeStepRay* rays, const float* radii, size_t count, uint32_t maxSteps, float* beamT,
+                        uint32_t* stepCounts)
+{
+    PARALLAX_CPU_SIMD_CALL(traceConeStepBeams, coneMap, rays, radii, count, maxSteps, beamT, stepCounts);
+}
+
+float certifyConeStepStart(const ConeTexture& coneMap, const ConeStepRay& ray, float t, uint32_t maxSteps, uint32_t& stepCount)
+{
+    stepCount = 0;
+    if (coneMap.empty() || t <= 0)
+        return 0;
+    const float3 ds = normalize(float3{ray.u2.x - ray.u.x, ray.u2.y - ray.u.y, 1});
+    const float iz = std::sqrt(1.0f - ds.z * ds.z);
+    const float w = 1.0f / coneMap.width;
+    const float startSc = t / ds.z;
+    float sc = startSc;
+    while (stepCount < maxSteps)
+    {
+        const float2 c = sampleCone(coneMap, ray.u + float2{ds.x, ds.y} * sc);
+        ++stepCount;
+        const float above = 1.0f - ds.z * sc - c.x;
+        if (above <= 0)
+            return -1;
+        // going back up, the ray leaves the cone where its horizontal distance outgrows the cone's radius
+        const float denom = iz - ds.z * c.y;
+        if (denom <= 0)
+            return startSc; // the ray is steeper than the cone: it stays inside up to the top plate
+        const float back = above * c.y / denom;
+        if (back >= sc)
+            return startSc;
+        if (back < w)
+            return -1;
+        sc -= back;
+    }
+    return -1;
+}
+
+ConeStepWarmStart warmStartConeStep(const ConeTexture& coneMap, const ConeStepRay& ray, float predictedT, float backoff, uint32_t maxSteps)
+{
+    ConeStepWarmStart ret;
+    // the minimum step of findIntersection_coneStepMapping in t
+    const float dt = normalize(float3{ray.u2.x - ray.u.x, ray.u2.y - ray.u.y, 1}).z / coneMap.width;
+    float tAbove = predictedT - backoff * dt, tBelow = std::min(predictedT + backoff * dt, 1.0f);
+    const float startSc = certifyConeStepStart(coneMap, ray, tAbove, maxSteps, ret.stepCount);
+    if (startSc <= 0)
+        return ret;
+    ret.startSc = startSc;
+    const auto isBelow = [&](float t)
+    {
+        ++ret.stepCount;
+        return 1.0f - t <= sampleCone(coneMap, lerp(ray.u, ray.u2, t)).x;
+    };
+    if (!isBelow(tBelow))
+        return ret;
+
+    while (tBelow - tAbove > dt)
+    {
+        const float t = 0.5f * (tAbove + tBelow);
+        (isBelow(t) ? tBelow : tAbove) = t;
+    }
+    ret.bracketed = true;
+    ret.hit.t = tBelow;
+    ret.hit.lastT = tAbove;
+    ret.hit.stepCount = ret.stepCount;
+    ret.hit.wasHit = true;
+    return ret;
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,76 @@
+#pragma once
+#include "Image.h"
+#include "TexelLayout.h"
+#include <cstddef>
+#include <vector>
+
+namespace ParallaxCpu
+{
+// The FScb constants of findIntersection_coneStepMapping
+struct ConeStepSettings
+{
+    uint32_t stepNum = 200;        // steps
+    float relax = 1.0f;            // relax
+    bool conservativeStep = false; // CONSERVATIVE_STEP
+};
+
+// A ray through the height field volume, from u at height 1 to u2 at height 0
+struct ConeStepRay
+{
+    float2 u;
+    float2 u2;
+};
+
+struct ConeStepHit
+{
+    float t = 0;     // the hit is at lerp(u, u2, t)
+    float lastT = 0; // the ray is above the surface up to here
+    uint32_t stepCount = 0;
+    bool wasHit = false; // false: ran out of steps
+};
+
+// CPU port of findIntersection_coneStepMapping for a single ray, the cone map is sampled bilinearly with clamping.
+// pSamples: also append the uv of every cone map sample
+// startSc: start stepping from here instead of the top plate, see certifyConeStepStart
+ConeStepHit traceConeStep(const ConeStepSettings& settings, const ConeTexture& coneMap, const ConeStepRay& ray, std::vector<float2>* pSamples = nullptr,
+                          float startSc = 0);
+
+// The same tracer on simd::kLanes rays at once. Every lane steps its own ray with gathered cone texels;
+// converged lanes are masked out, and once half of the lanes are idle they are refilled with the
+// next rays of the list, so the packet stays full until the list runs out.
+// Rays that are close on screen (one tile of pixels) keep the gathers in the same cache lines,
+// and a tiled or Morton cone texture keeps them there for rays that move in y.
+// pStartSc: the startSc of traceConeStep per ray; null: all rays start on the top plate
+void traceConeStepPackets(const ConeStepSettings& settings, const ConeTexture& coneMap, const ConeStepRay* rays, ConeStepHit* hits, size_t count,
+                          const float* pStartSc = nullptr);
+
+// Cone steps beams: the rays that are at most radii[i] (uv) away from rays[i] at every height, like the sub-samples of
+// a pixel around its central ray. Every step stays inside the cone of its sample at that distance from the ray too, so
+// a beam stops where the cone gets narrower than the radius or a step gets shorter than a texel; simd::kLanes beams
+// are stepped at once. beamT: the ray parameter t (lerp(u, u2, t)) down to which all rays of the beam are above the
+// height field, a ray of the beam can start cone stepping at t / ds.z. stepCounts: the cone samples taken
+void traceConeStepBeams(const ConeTexture& coneMap, const ConeStepRay* rays, const float* radii, size_t count, uint32_t maxSteps, float* beamT,
+                        uint32_t* stepCounts);
+
+// Certifies with the cone map that the ray is above the height field from the top plate down to ray parameter t
+// (lerp(u, u2, t), the ds.z * sc of cone stepping), so that cone stepping can start there. The cone of the texel
+// below a point above the surface is empty, and a ray that goes back up from the point stays in it for a distance
+// that the cone ratio gives; this steps back from cone to cone until the top plate is reached.
+// Returns the sc to start from, or a negative value when a point is below the surface, a backward step is shorter
+// than a texel or maxSteps cone samples are used up. stepCount: the cone samples taken
+float certifyConeStepStart(const ConeTexture& coneMap, const ConeStepRay& ray, float t, uint32_t maxSteps, uint32_t& stepCount);
+
+struct ConeStepWarmStart
+{
+    float startSc = 0;       // trace from here; 0: from the top plate
+    bool bracketed = false;  // no tracing needed, the hit is in [hit.lastT, hit.t]
+    ConeStepHit hit;
+    uint32_t stepCount = 0;  // the cone samples taken
+};
+
+// The temporal warm start of a ray whose hit is predicted at ray parameter predictedT, give or take `backoff`
+// minimum cone steps (a texel along the ray): certifies the ray down to the upper end, then samples the lower one.
+// Below the surface, the two bracket the hit, which is halved down to the minimum cone step; otherwise cone
+// stepping continues from the upper end.
+ConeStepWarmStart warmStartConeStep(const ConeTexture& coneMap, const ConeStepRay& ray, float predictedT, float backoff, uint32_t maxSteps);
+} // namespace ParallaxCpu
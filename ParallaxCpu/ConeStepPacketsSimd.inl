@@ -0,0 +1,253 @@
+// The tracer state and the packet tracers of ConeStepPackets.cpp, compiled per SIMD backend by SimdKernels.h
+namespace
+{
+using namespace simd;
+
+// Bilinear sample with clamp addressing, texel centers at (i + 0.5) / size
+float2 sampleCone(const ConeTexture& coneMap, float2 uv)
+{
+    const float fx = uv.x * coneMap.width - 0.5f, fy = uv.y * coneMap.height - 0.5f;
+    const float x0f = std::floor(fx), y0f = std::floor(fy);
+    const float wx = fx - x0f, wy = fy - y0f;
+    const float maxX = float(coneMap.width - 1), maxY = float(coneMap.height - 1);
+    const uint32_t x0 = (uint32_t)std::clamp(x0f, 0.0f, maxX), x1 = (uint32_t)std::clamp(x0f + 1, 0.0f, maxX);
+    const uint32_t y0 = (uint32_t)std::clamp(y0f, 0.0f, maxY), y1 = (uint32_t)std::clamp(y0f + 1, 0.0f, maxY);
+    const float2 top = coneMap(x0, y0) * (1 - wx) + coneMap(x1, y0) * wx;
+    const float2 bottom = coneMap(x0, y1) * (1 - wx) + coneMap(x1, y1) * wx;
+    return top * (1 - wy) + bottom * wy;
+}
+
+// The per ray constants and the loop state of findIntersection_coneStepMapping
+struct ConeStepState
+{
+    float2 u;
+    float3 ds;
+    float iz = 0;
+    float2 dirSign;
+    float sc = 0;
+    float2 t;
+    float zTimesSc = 0;
+    uint32_t stepCount = 0;
+
+    ConeStepState() = default;
+    ConeStepState(const ConeTexture& coneMap, const ConeStepRay& ray, float startSc = 0)
+        : u(ray.u)
+        , ds(normalize(float3{ray.u2.x - ray.u.x, ray.u2.y - ray.u.y, 1}))
+        , iz(std::sqrt(1.0f - ds.z * ds.z))
+        , dirSign{(ds.x < 0 ? -0.5f : 0.5f) / coneMap.width, (ds.y < 0 ? -0.5f : 0.5f) / coneMap.height}
+        , sc(startSc)
+        , t(sampleCone(coneMap, ray.u + float2{ds.x, ds.y} * startSc))
+        , zTimesSc(ds.z * startSc)
+    {}
+
+    ConeStepHit hit(uint32_t stepNum) const
+    {
+        ConeStepHit ret;
+        ret.t = ds.z * sc;
+        ret.lastT = zTimesSc;
+        ret.stepCount = stepCount;
+        ret.wasHit = stepCount < stepNum;
+        return ret;
+    }
+};
+struct vfloat2
+{
+    vfloat x, y;
+};
+
+// The height and cone tan of the texels (x, y) of the active lanes
+inline vfloat2 gatherTexels(const ConeTexture& coneMap, vint x, vint y, vmask active)
+{
+    // the height at stride * index, the cone tan coneOffset after it
+    const float* heights = coneMap.values.data();
+    const vint index = indexTexels(coneMap.indexer, x, y) * vint((int32_t)coneMap.stride);
+    return vfloat2{gather(heights, index, active), gather(heights + coneMap.coneOffset, index, active)};
+}
+
+// sampleCone for the active lanes, the 4 texels of every lane are gathered
+inline vfloat2 sampleCone(const ConeTexture& coneMap, vfloat u, vfloat v, vmask active)
+{
+    const vfloat fx = u * float(coneMap.width) - 0.5f, fy = v * float(coneMap.height) - 0.5f;
+    const vfloat x0f = floor(fx), y0f = floor(fy);
+    const vfloat wx = fx - x0f, wy = fy - y0f;
+    const vfloat maxX = float(coneMap.width - 1), maxY = float(coneMap.height - 1);
+    const vint x0 = truncToInt(clamp(x0f, 0.0f, maxX)), x1 = truncToInt(clamp(x0f + 1.0f, 0.0f, maxX));
+    const vint y0 = truncToInt(clamp(y0f, 0.0f, maxY)), y1 = truncToInt(clamp(y0f + 1.0f, 0.0f, maxY));
+
+    const vfloat2 t00 = gatherTexels(coneMap, x0, y0, active), t10 = gatherTexels(coneMap, x1, y0, active);
+    const vfloat2 t01 = gatherTexels(coneMap, x0, y1, active), t11 = gatherTexels(coneMap, x1, y1, active);
+    const vfloat2 top = {t00.x * (1.0f - wx) + t10.x * wx, t00.y * (1.0f - wx) + t10.y * wx};
+    const vfloat2 bottom = {t01.x * (1.0f - wx) + t11.x * wx, t01.y * (1.0f - wx) + t11.y * wx};
+    return {top.x * (1.0f - wy) + bottom.x * wy, top.y * (1.0f - wy) + bottom.y * wy};
+}
+
+// Copies the lane registers of traceConeStepPackets (regs, stepCount) to the lane states and back
+constexpr int kLaneRegs = 12;
+
+void storeLanes(vfloat* const regs[kLaneRegs], const vint& stepCount, ConeStepState* lanes)
+{
+    alignas(32) float a[kLaneRegs][kLanes];
+    alignas(32) int32_t steps[kLanes];
+    for (int r = 0; r < kLaneRegs; ++r)
+        regs[r]->store(a[r]);
+    stepCount.store(steps);
+    for (int i = 0; i < kLanes; ++i)
+    {
+        ConeStepState& s = lanes[i];
+        s.u = {a[0][i], a[1][i]};
+        s.ds = {a[2][i], a[3][i], a[4][i]};
+        s.iz = a[5][i];
+        s.dirSign = {a[6][i], a[7][i]};
+        s.sc = a[8][i];
+        s.t = {a[9][i], a[10][i]};
+        s.zTimesSc = a[11][i];
+        s.stepCount = (uint32_t)steps[i];
+    }
+}
+
+void loadLanes(const ConeStepState* lanes, vfloat* const regs[kLaneRegs], vint& stepCount)
+{
+    alignas(32) float a[kLaneRegs][kLanes];
+    alignas(32) int32_t steps[kLanes];
+    for (int i = 0; i < kLanes; ++i)
+    {
+        const ConeStepState& s = lanes[i];
+        const float values[kLaneRegs] = {s.u.x, s.u.y, s.ds.x, s.ds.y, s.ds.z, s.iz, s.dirSign.x, s.dirSign.y, s.sc, s.t.x, s.t.y, s.zTimesSc};
+        for (int r = 0; r < kLaneRegs; ++r)
+            a[r][i] = values[r];
+        steps[i] = (int32_t)s.stepCount;
+    }
+    for (int r = 0; r < kLaneRegs; ++r)
+        *regs[r] = vfloat::load(a[r]);
+    stepCount = vint::load(steps);
+}
+} // namespace
+
+void traceConeStepPackets(const ConeStepSettings& settings, const ConeTexture& coneMap, const ConeStepRay* rays, ConeStepHit* hits, size_t count,
+                          const float* pStartSc)
+{
+    if (count == 0 || coneMap.empty())
+        return;
+    const vfloat HMresX = float(coneMap.width), HMresY = float(coneMap.height);
+    const vfloat relax = settings.relax;
+    const vint stepNum = (int32_t)std::min(settings.stepNum, 0x7fffffffu);
+
+    // lane states live in registers while they step and in `lanes` while idle lanes are refilled
+    ConeStepState lanes[kLanes];
+    size_t laneRay[kLanes];
+    const size_t kNoRay = ~size_t(0);
+    std::fill(laneRay, laneRay + kLanes, kNoRay);
+    size_t nextRay = 0;
+
+    vfloat uX = 0.0f, uY = 0.0f, dsX = 0.0f, dsY = 0.0f, dsZ = 0.0f, iz = 0.0f, dirSignX = 0.0f, dirSignY = 0.0f;
+    vfloat sc = 0.0f, tX = 0.0f, tY = 0.0f, zTimesSc = 0.0f;
+    vint stepCount = 0;
+    vmask active(false);
+
+    vfloat* const regs[kLaneRegs] = {&uX, &uY, &dsX, &dsY, &dsZ, &iz, &dirSignX, &dirSignY, &sc, &tX, &tY, &zTimesSc};
+
+    for (;;)
+    {
+        // the loop condition of the shader, per lane
+        active = active & (vfloat(1.0f) - dsZ * sc > tX) & (stepCount < stepNum);
+        const uint32_t activeBits = bits(active);
+        const int activeCount = (int)std::bitset<kLanes>(activeBits).count();
+        if (activeCount <= kLanes / 2 && (nextRay < count || activeCount == 0))
+        {
+            // write out the finished lanes and start the next rays in them
+            storeLanes(regs, stepCount, lanes);
+            for (int i = 0; i < kLanes; ++i)
+            {
+                if (activeBits & (1u << i))
+                    continue;
+                if (laneRay[i] != kNoRay)
+                    hits[laneRay[i]] = lanes[i].hit(settings.stepNum);
+                laneRay[i] = kNoRay;
+                if (nextRay < count)
+                {
+                    laneRay[i] = nextRay;
+                    lanes[i] = ConeStepState(coneMap, rays[nextRay], pStartSc ? pStartSc[nextRay] : 0.0f);
+                    ++nextRay;
+                }
+            }
+            loadLanes(lanes, regs, stepCount);
+            // refilled lanes start by testing the loop condition
+            alignas(32) int32_t occupied[kLanes];
+            for (int i = 0; i < kLanes; ++i)
+                occupied[i] = laneRay[i] != kNoRay ? 1 : 0;
+            active = vint::load(occupied) != vint(0);
+            if (none(active))
+                return;
+            continue;
+        }
+
+        zTimesSc = select(active, dsZ * sc, zTimesSc);
+        vfloat w = vfloat(1.0f) / HMresX;
+        if (settings.conservativeStep)
+        {
+            const vfloat pX = uX + dsX * sc, pY = uY + dsY * sc;
+            const vfloat wallX = (floor(pX * HMresX - 0.5f) + 1.0f) / HMresX + dirSignX;
+            const vfloat wallY = (floor(pY * HMresY - 0.5f) + 1.0f) / HMresY + dirSignY;
+            // operands swapped so that a NaN wall distance is skipped like in std::min
+            w = min((wallY - pY) / dsY, (wallX - pX) / dsX) + 1e-5f;
+        }
+        const vfloat step = relax * max((vfloat(1.0f) - zTimesSc - tX) * tY / (tY * dsZ + iz), w);
+        sc = select(active, sc + step, sc);
+
+        const vfloat2 t = sampleCone(coneMap, uX + dsX * sc, uY + dsY * sc, active);
+        tX = select(active, t.x, tX);
+        tY = select(active, t.y, tY);
+        stepCount = select(active, stepCount + 1, stepCount);
+    }
+}
+
+void traceConeStepBeams(const ConeTexture& coneMap, const ConeStepRay* rays, const float* radii, size_t count, uint32_t maxSteps, float* beamT,
+                        uint32_t* stepCounts)
+{
+    if (coneMap.empty())
+    {
+        std::fill(beamT, beamT + count, 0.0f);
+        std::fill(stepCounts, stepCounts + count, 0u);
+        return;
+    }
+    const vfloat w = 1.0f / coneMap.width;
+    const vint steps = (int32_t)std::min(maxSteps, 0x7fffffffu);
+    for (size_t first = 0; first < count; first += kLanes)
+    {
+        const int laneCount = (int)std::min<size_t>(kLanes, count - first);
+        alignas(32) float a[6][kLanes] = {};
+        for (int i = 0; i < laneCount; ++i)
+        {
+            const ConeStepRay& ray = rays[first + i];
+            const float3 ds = normalize(float3{ray.u2.x - ray.u.x, ray.u2.y - ray.u.y, 1});
+            const float values[6] = {ray.u.x, ray.u.y, ds.x, ds.y, ds.z, radii[first + i]};
+            for (int r = 0; r < 6; ++r)
+                a[r][i] = values[r];
+        }
+        const vfloat uX = vfloat::load(a[0]), uY = vfloat::load(a[1]), dsX = vfloat::load(a[2]), dsY = vfloat::load(a[3]);
+        const vfloat dsZ = vfloat::load(a[4]), radius = vfloat::load(a[5]);
+        const vfloat iz = sqrt(vfloat(1.0f) - dsZ * dsZ);
+        vfloat sc = 0.0f;
+        vint stepCount = 0;
+        vmask active = (vint::iota(0) < vint(laneCount)) & (stepCount < steps);
+        while (any(active))
+        {
+            const vfloat2 t = sampleCone(coneMap, uX + dsX * sc, uY + dsY * sc, active);
+            stepCount = select(active, stepCount + 1, stepCount);
+            // the step of traceConeStep, up to where the ray's distance from the cone's axis plus the radius reaches the cone
+            const vfloat step = ((vfloat(1.0f) - dsZ * sc - t.x) * t.y - radius) / (t.y * dsZ + iz);
+            active = active & (step >= w);
+            sc = select(active, sc + step, sc);
+            active = active & (stepCount < steps);
+        }
+        alignas(32) float t[kLanes];
+        alignas(32) int32_t n[kLanes];
+        (dsZ * sc).store(t);
+        stepCount.store(n);
+        for (int i = 0; i < laneCount; ++i)
+        {
+            beamT[first + i] = t[i];
+            stepCounts[first + i] = (uint32_t)n[i];
+        }
+    }
+}
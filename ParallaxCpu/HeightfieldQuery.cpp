@@ -0,0 +1,271 @@
+#include "HeightfieldQuery.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace ParallaxCpu
+{
+namespace
+{
+RenderSettings makeQuerySettings(RenderSettings settings, HeightfieldTracer tracer)
+{
+    settings.selectedParallaxFun = (uint32_t)tracer;
+    settings.selectedShadowFun = 0;
+    settings.ADAPTIVE_STEPS = false; // the packets trace every lane with the same budget
+    return settings;
+}
+
+// Narrows [t0, t1] of p(t) = lerp(a, b, t) to where p is in [0, 1]
+void clipToUnit(float a, float b, float& t0, float& t1)
+{
+    const float d = b - a;
+    if (d == 0)
+    {
+        if (a < 0 || a > 1)
+            t1 = -1;
+        return;
+    }
+    const float tA = -a / d, tB = (1 - a) / d;
+    t0 = std::max(t0, std::min(tA, tB));
+    t1 = std::min(t1, std::max(tA, tB));
+}
+
+// The first t in [t0, t1] with a t^2 + b t + c >= 0, given that it is negative at t0
+bool firstRoot(double a, double b, double c, double t0, double t1, double& t)
+{
+    if (std::abs(a) < 1e-12)
+    {
+        if (b == 0)
+            return false;
+        t = -c / b;
+        return t0 <= t && t <= t1;
+    }
+    const double det = b * b - 4 * a * c;
+    if (det < 0)
+        return false;
+    const double q = -0.5 * (b + std::copysign(std::sqrt(det), b));
+    double r0 = q / a, r1 = q != 0 ? c / q : r0;
+    if (r0 > r1)
+        std::swap(r0, r1);
+    for (double r : {r0, r1})
+    {
+        if (t0 <= r && r <= t1)
+        {
+            t = r;
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+HeightfieldQuery::HeightfieldQuery(const HeightImage& heightmap, HeightfieldTracer tracer, const RenderSettings& settings, ConeImage coneMap)
+    : mSettings(makeQuerySettings(settings, tracer))
+    , mRenderer(heightmap)
+    , mHeights(heightmap.width, heightmap.height)
+{
+    std::transform(heightmap.texels.begin(), heightmap.texels.end(), mHeights.texels.begin(), unorm16ToFloat);
+    if (tracer == HeightfieldTracer::MaxMip && !heightmap.empty())
+        mHeightOffset = {0.5f / heightmap.width, 0.5f / heightmap.height};
+    // the world normal of the square is heightMapHeight long, see toWorldPoint in Renderer.cpp
+    mDepth = mSettings.heightMapHeight / std::abs(mSettings.scale.y);
+    if (!coneMap.empty())
+        mRenderer.setConeMap(std::move(coneMap));
+    mRenderer.prepareTracer(mSettings);
+}
+
+float3 HeightfieldQuery::toModelPoint(float3 p) const
+{
+    return toModelDirection(p - mSettings.translate);
+}
+
+float3 HeightfieldQuery::toModelDirection(float3 d) const
+{
+    const float3 r = rotate(d, -mSettings.angle, normalize(mSettings.axis));
+    return float3{r.x / mSettings.scale.x, r.y / mSettings.scale.y, r.z / mSettings.scale.z};
+}
+
+float3 HeightfieldQuery::toWorldPoint(float3 p) const
+{
+    return mSettings.translate + rotate(p * mSettings.scale, mSettings.angle, normalize(mSettings.axis));
+}
+
+// the inverse transpose of rotate * scale
+float3 HeightfieldQuery::toWorldNormal(float3 n) const
+{
+    const float3 scale = mSettings.scale;
+    return normalize(rotate(float3{n.x / scale.x, n.y / scale.y, n.z / scale.z}, mSettings.angle, normalize(mSettings.axis)));
+}
+
+// The texture clamps, the corners of MaxMip past the last texel load 0 like MaxMipTexture.Load
+float HeightfieldQuery::getTexel(int32_t x, int32_t y) const
+{
+    if (mHeightOffset.x > 0 && (x >= (int32_t)mHeights.width || y >= (int32_t)mHeights.height))
+        return 0.0f;
+    return mHeights(std::clamp(x, 0, (int32_t)mHeights.width - 1), std::clamp(y, 0, (int32_t)mHeights.height - 1));
+}
+
+HeightfieldQuery::Patch HeightfieldQuery::getPatch(float2 uv) const
+{
+    const float fx = (uv.x + mHeightOffset.x) * mHeights.width - 0.5f, fy = (uv.y + mHeightOffset.y) * mHeights.height - 0.5f;
+    const float x0f = std::floor(fx), y0f = std::floor(fy);
+    const int32_t x0 = (int32_t)x0f, y0 = (int32_t)y0f;
+    return {getTexel(x0, y0), getTexel(x0 + 1, y0), getTexel(x0, y0 + 1), getTexel(x0 + 1, y0 + 1), fx - x0f, fy - y0f};
+}
+
+float HeightfieldQuery::surfaceHeight(float2 uv) const
+{
+    const Patch p = getPatch(uv);
+    return (p.h00 * (1 - p.wx) + p.h10 * p.wx) * (1 - p.wy) + (p.h01 * (1 - p.wx) + p.h11 * p.wx) * p.wy;
+}
+
+// The surface y = depth * (h - 1) over x = 2u - 1, z = 2v - 1 has the model normal (-dy/dx, 1, -dy/dz)
+float3 HeightfieldQuery::surfaceNormal(float2 uv) const
+{
+    const Patch p = getPatch(uv);
+    const float dhdu = ((p.h10 - p.h00) * (1 - p.wy) + (p.h11 - p.h01) * p.wy) * mHeights.width;
+    const float dhdv = ((p.h01 - p.h00) * (1 - p.wx) + (p.h11 - p.h10) * p.wx) * mHeights.height;
+    return normalize(float3{-0.5f * mDepth * dhdu, 1.0f, -0.5f * mDepth * dhdv});
+}
+
+void HeightfieldQuery::setHit(const HeightfieldRay& ray, float t, float2 uv, HeightfieldHit& hit) const
+{
+    hit.hit = true;
+    hit.t = t;
+    hit.position = ray.origin + t * ray.direction;
+    hit.normal = surfaceNormal(uv);
+    hit.worldPosition = toWorldPoint(hit.position);
+    hit.worldNormal = toWorldNormal(hit.normal);
+    hit.uv = uv;
+}
+
+// Walks the cells of getPatch along the ray and solves the quadratic of each one in double precision, like intersectExact
+// of RayBench.cpp but for any direction and with the surface of the tracer
+HeightfieldHit HeightfieldQuery::traceCells(const HeightfieldRay& ray) const
+{
+    HeightfieldHit hit;
+    if (mHeights.empty() || !(mDepth > 0))
+        return hit;
+    // clip to the volume: uv in [0, 1] and the height above the bottom plate relative to the depth, r, in [0, 1]
+    const float2 uv0 = {ray.origin.x * 0.5f + 0.5f, ray.origin.z * 0.5f + 0.5f}, duv = {ray.direction.x * 0.5f, ray.direction.z * 0.5f};
+    const float r0 = 1 + ray.origin.y / mDepth, dr = ray.direction.y / mDepth;
+    float s0 = 0, s1 = ray.tMax;
+    clipToUnit(uv0.x, uv0.x + duv.x, s0, s1);
+    clipToUnit(uv0.y, uv0.y + duv.y, s0, s1);
+    clipToUnit(r0, r0 + dr, s0, s1);
+    if (!(s0 <= s1))
+        return hit;
+
+    // texel space with the texel centers of getPatch on integers: p(s) = p0 + s d
+    const double size[2] = {double(mHeights.width), double(mHeights.height)};
+    const double p0[2] = {(uv0.x + mHeightOffset.x) * size[0] - 0.5, (uv0.y + mHeightOffset.y) * size[1] - 0.5};
+    const double d[2] = {duv.x * size[0], duv.y * size[1]};
+    int32_t cell[2];
+    for (int a = 0; a < 2; ++a)
+    {
+        const double p = p0[a] + s0 * d[a];
+        cell[a] = (int32_t)std::floor(p);
+        if (d[a] < 0 && p == cell[a])
+            --cell[a];
+    }
+    const double inf = std::numeric_limits<double>::infinity();
+    double s = s0;
+    for (;;)
+    {
+        double sNext[2];
+        for (int a = 0; a < 2; ++a)
+            sNext[a] = d[a] > 0 ? (cell[a] + 1 - p0[a]) / d[a] : d[a] < 0 ? (cell[a] - p0[a]) / d[a] : inf;
+        const double sExit = std::min(double(s1), std::min(sNext[0], sNext[1]));
+
+        // the bilinear height along the ray minus the ray height, a quadratic in s
+        const double h00 = getTexel(cell[0], cell[1]), h10 = getTexel(cell[0] + 1, cell[1]);
+        const double h01 = getTexel(cell[0], cell[1] + 1), h11 = getTexel(cell[0] + 1, cell[1] + 1);
+        const double e1 = h10 - h00, e2 = h01 - h00, e3 = h00 - h10 - h01 + h11;
+        const double ax = p0[0] - cell[0], bx = d[0], ay = p0[1] - cell[1], by = d[1];
+        const double qa = e3 * bx * by;
+        const double qb = e1 * bx + e2 * by + e3 * (ax * by + bx * ay) - dr;
+        const double qc = h00 + e1 * ax + e2 * ay + e3 * ax * ay - r0;
+        double sHit = s;
+        if (qa * s * s + qb * s + qc >= 0 || firstRoot(qa, qb, qc, s, sExit, sHit))
+        {
+            const float t = float(sHit);
+            setHit(ray, t, uv0 + t * duv, hit);
+            hit.converged = true;
+            return hit;
+        }
+        if (sExit >= s1)
+            return hit;
+        for (int a = 0; a < 2; ++a)
+            cell[a] += sNext[a] == sExit ? (d[a] > 0 ? 1 : -1) : 0;
+        s = sExit;
+    }
+}
+
+void HeightfieldQuery::trace(const HeightfieldRay* rays, HeightfieldHit* hits, size_t count) const
+{
+    // the rays that enter the volume, a chunk at a time: the volume ray from the top plate (t = 0) to the bottom plate
+    // (t = 1) and the part of it that the query covers
+    const size_t kChunk = 256;
+    std::vector<ConeStepRay> volumeRays;
+    std::vector<RayHit> volumeHits;
+    std::vector<float> startT, endT;
+    std::vector<size_t> rayIndex;
+    std::vector<std::pair<float, float>> plates; // the ray's t on the top and on the bottom plate
+    volumeRays.reserve(kChunk);
+    for (size_t first = 0; first < count; first += kChunk)
+    {
+        volumeRays.clear();
+        startT.clear();
+        endT.clear();
+        rayIndex.clear();
+        plates.clear();
+        for (size_t i = first; i < std::min(count, first + kChunk); ++i)
+        {
+            hits[i] = {};
+            const HeightfieldRay& ray = rays[i];
+            if (!(ray.direction.y < 0))
+            {
+                // the tracers only go down from the top plate
+                hits[i] = traceCells(ray);
+                continue;
+            }
+            const float sTop = -ray.origin.y / ray.direction.y, sBottom = (-mDepth - ray.origin.y) / ray.direction.y;
+            const float3 top = ray.origin + sTop * ray.direction, bottom = ray.origin + sBottom * ray.direction;
+            const ConeStepRay volumeRay = {{top.x * 0.5f + 0.5f, top.z * 0.5f + 0.5f}, {bottom.x * 0.5f + 0.5f, bottom.z * 0.5f + 0.5f}};
+            float t0 = std::max(0.0f, -sTop / (sBottom - sTop)), t1 = std::min(1.0f, (ray.tMax - sTop) / (sBottom - sTop));
+            clipToUnit(volumeRay.u.x, volumeRay.u2.x, t0, t1);
+            clipToUnit(volumeRay.u.y, volumeRay.u2.y, t0, t1);
+            if (!(t0 <= t1))
+                continue;
+
+            const float2 uv0 = lerp(volumeRay.u, volumeRay.u2, t0);
+            if (surfaceHeight(uv0) >= 1 - t0)
+            {
+                // starts below the surface
+                setHit(ray, std::max(0.0f, sTop + t0 * (sBottom - sTop)), uv0, hits[i]);
+                hits[i].converged = true;
+                continue;
+            }
+            volumeRays.push_back(volumeRay);
+            startT.push_back(t0);
+            endT.push_back(t1);
+            rayIndex.push_back(i);
+            plates.push_back({sTop, sBottom});
+        }
+
+        volumeHits.resize(volumeRays.size());
+        mRenderer.traceRaysPrepared(mSettings, volumeRays.data(), volumeHits.data(), volumeRays.size(), nullptr, nullptr, startT.data());
+        for (size_t j = 0; j < volumeRays.size(); ++j)
+        {
+            const RayHit& volumeHit = volumeHits[j];
+            if (volumeHit.state == TraceState::Missed || volumeHit.t > endT[j])
+                continue;
+            HeightfieldHit& hit = hits[rayIndex[j]];
+            setHit(rays[rayIndex[j]], plates[j].first + std::max(volumeHit.t, startT[j]) * (plates[j].second - plates[j].first), volumeHit.uv, hit);
+            hit.converged = volumeHit.state == TraceState::Hit;
+        }
+    }
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,94 @@
+#pragma once
+#include "Image.h"
+#include "Math.h"
+#include "RenderSettings.h"
+#include "Renderer.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace ParallaxCpu
+{
+// The tracers of HeightfieldQuery, valued by the PARALLAX_FUN they run
+enum class HeightfieldTracer : uint32_t
+{
+    ConeStep = 3,       // cone step mapping in SIMD packets; ends within a step of the surface unless REFINE_FUN refines it
+    MaxMip = 10,        // Seidel's Maximum Mip, exact on the bilinear patches of the pyramid's cells, see below
+    BilinearPatch = 12, // QDM on the bilinear-conservative pyramid, exact on the bilinear surface through the texel centers
+};
+
+// A ray in the model frame of the square: the top plate is y = 0 with |x|, |z| <= 1 and texture coordinates
+// (x, z) * 0.5 + 0.5; the height field hangs below it down to y = -HeightfieldQuery::getDepth()
+struct HeightfieldRay
+{
+    float3 origin;
+    float3 direction;
+    float tMax = std::numeric_limits<float>::infinity(); // the ray ends at origin + tMax * direction
+};
+
+struct HeightfieldHit
+{
+    bool hit = false;       // the ray meets the surface within tMax
+    bool converged = false; // false: the tracer ran out of steps and the hit is its last estimate
+    float t = std::numeric_limits<float>::infinity(); // position = origin + t * direction
+    float3 position;        // model frame
+    float3 normal;          // model frame, unit
+    float3 worldPosition;   // position and normal in world space
+    float3 worldNormal;
+    float2 uv;              // texture coordinates of the hit
+};
+
+// Ray queries against the displaced surface of Parallax.ps.slang for game logic: projectile hits, foot placement and
+// line of sight. The CPU ports of the shader's tracers answer them, so a query matches the surface that the same
+// tracer renders. The textures are built by the constructor and trace() only reads them, so any number of threads can
+// query one HeightfieldQuery at once.
+// The tracers take the rays that go down into the height field (direction.y < 0). Level and rising rays, such as a line
+// of sight or an upward projectile, walk the texel cells instead and are intersected exactly with the tracer's surface.
+// A ray can start inside the volume; one that starts below the surface, or enters the volume through a side below it,
+// hits where it enters, whatever its direction.
+// MaxMip answers against a surface half a texel off the one of ConeStep and BilinearPatch, as the shader renders it: its
+// height at uv is theirs at uv + 0.5 / size, and 0 past the last texel. Like the shader's Maximum Mip, it needs a square
+// power of two heightmap.
+// Only ConeStep traces in SIMD packets; MaxMip and BilinearPatch trace one ray at a time, like the shader ports they run.
+// ParallaxCpuRayBench querycheck checks the hits against the exact intersection and from several threads at once.
+class HeightfieldQuery
+{
+public:
+    // settings: the surface, heightMapHeight and the model transform (scale, angle, axis, translate), and the constants of
+    // the tracer (stepNum, relax, REFINE_FUN, ...). PARALLAX_FUN is the tracer's and ADAPTIVE_STEPS is off.
+    // coneMap: the cone map of ConeStep; empty: the quick conemap is baked
+    HeightfieldQuery(const HeightImage& heightmap, HeightfieldTracer tracer, const RenderSettings& settings = {}, ConeImage coneMap = {});
+
+    // Traces count rays into count hits on the calling thread, simd::kLanes ConeStep rays at a time
+    void trace(const HeightfieldRay* rays, HeightfieldHit* hits, size_t count) const;
+
+    // The model frame of world positions and directions, for rays in world space; t is the same in both frames
+    float3 toModelPoint(float3 p) const;
+    float3 toModelDirection(float3 d) const;
+    float3 toWorldPoint(float3 p) const;
+    float3 toWorldNormal(float3 n) const;
+    // heightMapHeight in the model frame
+    float getDepth() const { return mDepth; }
+
+private:
+    // the 4 texels and the weights of the bilinear surface under uv that the tracer intersects
+    struct Patch
+    {
+        float h00, h10, h01, h11;
+        float wx, wy;
+    };
+    float getTexel(int32_t x, int32_t y) const;
+    Patch getPatch(float2 uv) const;
+    // level and rising rays
+    HeightfieldHit traceCells(const HeightfieldRay& ray) const;
+    float surfaceHeight(float2 uv) const;
+    float3 surfaceNormal(float2 uv) const;
+    void setHit(const HeightfieldRay& ray, float t, float2 uv, HeightfieldHit& hit) const;
+
+    RenderSettings mSettings;
+    Renderer mRenderer;
+    Image<float> mHeights;
+    float2 mHeightOffset; // MaxMip intersects the surface half a texel off
+    float mDepth = 0;
+};
+} // namespace ParallaxCpu
@@ -0,0 +1,91 @@
+#include "HybridConemap.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+#define PARALLAX_CPU_SIMD_KERNELS "HybridConemapSimd.inl"
+#include "SimdKernels.h"
+
+namespace ParallaxCpu
+{
+namespace
+{
+LayoutImage<float> toFloatHeights(const HeightImage& heightmap, TexelLayout layout)
+{
+    LayoutImage<float> heights(heightmap.width, heightmap.height, layout);
+    for (uint32_t y = 0; y < heightmap.height; ++y)
+        for (uint32_t x = 0; x < heightmap.width; ++x)
+            heights(x, y) = unorm16ToFloat(heightmap(x, y));
+    return heights;
+}
+} // namespace
+
+float calcFallingEdgeTan(const LayoutImage<float>& heights, uint32_t x, uint32_t y)
+{
+    return PARALLAX_CPU_SIMD_CALL(calcFallingEdgeTan, heights, x, y);
+}
+
+ConeImage generateFallingEdgeConemap(const HeightImage& heightmap, TexelLayout layout)
+{
+    const LayoutImage<float> heights = toFloatHeights(heightmap, layout);
+    ConeImage coneMap(heightmap.width, heightmap.height);
+    parallelFor(0, heightmap.height, [&](uint32_t y)
+    {
+        for (uint32_t x = 0; x < heightmap.width; ++x)
+            coneMap(x, y) = {heights(x, y), calcFallingEdgeTan(heights, x, y)};
+    });
+    return coneMap;
+}
+
+ConeImage generateHybridConemap(const HybridConemapSettings& settings, const HeightImage& heightmap, uint32_t* pRefinedTexelCount)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+
+    ConeImage coneMap = generateQuickConemap(settings.quick, heightmap);
+    const size_t texelCount = coneMap.texels.size();
+    const size_t refineCount = std::min(texelCount, size_t(std::max(0.0f, settings.texelFraction) * texelCount));
+    if (pRefinedTexelCount)
+        *pRefinedTexelCount = 0;
+    if (refineCount == 0)
+        return coneMap;
+
+    // Expected benefit: the step count near a texel goes with 1 / tan, and narrow quick cones are
+    // also cheap to refine (the exact search stops at a radius proportional to its cone).
+    // Weighting with the depth (1 - height) ranked slow, low texels first and gained less per ms.
+    const float minTan = 1.0f / std::max(heightmap.width, heightmap.height);
+    std::vector<float> benefit(texelCount);
+    for (size_t i = 0; i < texelCount; ++i)
+        benefit[i] = 1.0f / std::max(coneMap.texels[i].y, minTan);
+    std::vector<uint32_t> order(texelCount);
+    std::iota(order.begin(), order.end(), 0u);
+    auto higherBenefit = [&](uint32_t a, uint32_t b) { return benefit[a] > benefit[b]; };
+    std::nth_element(order.begin(), order.begin() + (refineCount - 1), order.end(), higherBenefit);
+    std::sort(order.begin(), order.begin() + refineCount, higherBenefit);
+
+    // Refine in ranked chunks; chunks that start after the deadline are skipped
+    const LayoutImage<float> heights = toFloatHeights(heightmap, TexelLayout::RowMajor);
+    const bool hasDeadline = settings.timeBudgetMs > 0;
+    const auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::milli>(settings.timeBudgetMs));
+    const uint32_t kChunk = 64;
+    std::atomic<uint32_t> refined{0};
+    parallelFor(0, uint32_t((refineCount + kChunk - 1) / kChunk), [&](uint32_t chunk)
+    {
+        if (hasDeadline && Clock::now() >= deadline)
+            return;
+        const size_t last = std::min(refineCount, size_t(chunk + 1) * kChunk);
+        for (size_t i = size_t(chunk) * kChunk; i < last; ++i)
+        {
+            const uint32_t x = order[i] % heightmap.width, y = order[i] / heightmap.width;
+            coneMap(x, y).y = calcFallingEdgeTan(heights, x, y);
+        }
+        refined += uint32_t(last - size_t(chunk) * kChunk);
+    });
+    if (pRefinedTexelCount)
+        *pRefinedTexelCount = refined;
+    return coneMap;
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,27 @@
+#pragma once
+#include "Image.h"
+#include "QuickConemap.h"
+#include "TexelLayout.h"
+
+namespace ParallaxCpu
+{
+struct HybridConemapSettings
+{
+    QuickConemapSettings quick;
+    float texelFraction = 0.1f; // share of the texels that get the exact search, in ranked order
+    float timeBudgetMs = 0.0f;  // stop refining after this much time; 0: no limit
+};
+
+// CPU port of main_new_fallingEdge in Conemap.cs.slang: the exact cone of one texel
+float calcFallingEdgeTan(const LayoutImage<float>& heights, uint32_t x, uint32_t y);
+
+// The exact falling edge cone map of the whole texture (CONE_TYPE 4).
+// layout: texel order of the heights the ring search reads; the result is the same for every layout.
+ConeImage generateFallingEdgeConemap(const HeightImage& heightmap, TexelLayout layout = TexelLayout::RowMajor);
+
+// Quick conemap whose most promising texels are replaced by their exact falling edge cone.
+// Texels are ranked by their quick cone (narrowest first, where rays spend the most steps)
+// and refined in that order until the texel fraction or the time budget runs out.
+// Refined texels get the same cone as the full falling edge bake, so the result stays conservative.
+ConeImage generateHybridConemap(const HybridConemapSettings& settings, const HeightImage& heightmap, uint32_t* pRefinedTexelCount = nullptr);
+} // namespace ParallaxCpu
@@ -0,0 +1,79 @@
+// The falling edge search of HybridConemap.cpp, compiled per SIMD backend by SimdKernels.h
+namespace
+{
+using namespace simd;
+
+// One ring segment of main_new_fallingEdge: the texels (i, j) + k * step for k in [0, count)
+// are checked with updateMinTan, kLanes at a time. dirX/dirY is the direction of their cells.
+// Pruning with the minTan of the packet start instead of the running one only lets through
+// texels that cannot lower the result, so this matches the sequential shader loop.
+void updateMinTanSegment(const LayoutImage<float>& heights, float baseH, float2 baseT, float2 texelSize, int32_t i, int32_t j, int32_t stepI, int32_t stepJ,
+                         int32_t count, int32_t dirX, int32_t dirY, float& minTan)
+{
+    const int32_t w = (int32_t)heights.width;
+    // the cell (dstIJ, dstIJ + dir) has to be inside the texture
+    const int32_t minI = dirX > 0 ? 0 : 1, maxI = dirX > 0 ? w - 2 : w - 1;
+    const int32_t minJ = dirY > 0 ? 0 : 1, maxJ = dirY > 0 ? (int32_t)heights.height - 2 : (int32_t)heights.height - 1;
+    const float* h = heights.texels.data();
+
+    for (int32_t k0 = 0; k0 < count; k0 += kLanes)
+    {
+        const vint k = vint::iota(k0);
+        const vint ii = vint(i) + k * vint(stepI);
+        const vint jj = vint(j) + k * vint(stepJ);
+        const vmask inside = firstLanes(count - k0) & (ii >= vint(minI)) & (ii <= vint(maxI)) & (jj >= vint(minJ)) & (jj <= vint(maxJ));
+        if (none(inside))
+            continue;
+
+        const vfloat dx = (toFloat(ii) + vfloat(0.5f)) * vfloat(texelSize.x) - vfloat(baseT.x);
+        const vfloat dy = (toFloat(jj) + vfloat(0.5f)) * vfloat(texelSize.y) - vfloat(baseT.y);
+        const vfloat dist = sqrt(dx * dx + dy * dy);
+        // the cone is already over the max height
+        vmask m = inside & (dist < vfloat(minTan * (1 - baseH)));
+        if (none(m))
+            continue;
+
+        const vfloat h00 = gather(h, indexTexels(heights.indexer, ii, jj), m);
+        const vfloat deltaH = h00 - vfloat(baseH);
+        // the checked point is under the cone
+        m = m & (dist < vfloat(minTan) * deltaH);
+        if (none(m))
+            continue;
+
+        const vint ii1 = ii + vint(dirX), jj1 = jj + vint(dirY);
+        const vfloat h10 = gather(h, indexTexels(heights.indexer, ii1, jj), m);
+        const vfloat h01 = gather(h, indexTexels(heights.indexer, ii, jj1), m);
+        const vfloat h11 = gather(h, indexTexels(heights.indexer, ii1, jj1), m);
+        m = m & ((h00 > h10) | (h00 > h01) | (h10 > h11) | (h01 > h11));
+        if (any(m))
+            minTan = std::min(minTan, reduceMin(select(m, dist / deltaH, vfloat(1.0f))));
+    }
+}
+} // namespace
+
+float calcFallingEdgeTan(const LayoutImage<float>& heights, uint32_t x, uint32_t y)
+{
+    const int32_t w = (int32_t)heights.width;
+    const int32_t h = (int32_t)heights.height;
+    const float2 texelSize = {1.0f / w, 1.0f / h};
+    const float2 baseT = {(x + 0.5f) * texelSize.x, (y + 0.5f) * texelSize.y};
+    const float baseH = heights(x, y);
+    // the shader assumes square textures here; the smaller texel size keeps the early out safe for any aspect
+    const float ringStep = std::min(texelSize.x, texelSize.y);
+
+    const int32_t dirs[4][2] = {{1, 1}, {-1, 1}, {1, -1}, {-1, -1}};
+    float minTan = 1;
+    for (int32_t r = 1; r <= std::max(w, h); ++r)
+    {
+        // early out when the cone is already too narrow
+        if (r * ringStep >= minTan * (1 - baseH))
+            break;
+
+        for (const auto& dd : dirs)
+        {
+            updateMinTanSegment(heights, baseH, baseT, texelSize, (int32_t)x + dd[0] * r, (int32_t)y, 0, dd[1], r + 1, dd[0], dd[1], minTan);
+            updateMinTanSegment(heights, baseH, baseT, texelSize, (int32_t)x, (int32_t)y + dd[1] * r, dd[0], 0, r, dd[0], dd[1], minTan);
+        }
+    }
+    return minTan;
+}
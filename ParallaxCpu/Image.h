@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ParallaxCpu
+{
+struct float2
+{
+    float x = 0, y = 0;
+};
+
+// Row-major 2D texel storage
+template<typename T>
+struct Image
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<T> texels;
+
+    Image() = default;
+    Image(uint32_t w, uint32_t h, const T& value = T()) : width(w), height(h), texels(size_t(w) * h, value) {}
+
+    T& operator()(uint32_t x, uint32_t y) { return texels[size_t(y) * width + x]; }
+    const T& operator()(uint32_t x, uint32_t y) const { return texels[size_t(y) * width + x]; }
+    bool empty() const { return texels.empty(); }
+};
+
+// Heights as 16 bit unorm values; R8 sources are expanded exactly (v * 257)
+using HeightImage = Image<uint16_t>;
+// [height, cone tan] per texel, the same layout as the RG cone map textures
+using ConeImage = Image<float2>;
+
+inline float unorm16ToFloat(uint16_t v)
+{
+    return float(v) * (1.0f / 65535.0f);
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,148 @@
+#include "ImageIO.h"
+#include <array>
+#include <cstdio>
+#include <fstream>
+
+namespace ParallaxCpu
+{
+namespace
+{
+uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+{
+    static const std::array<uint32_t, 256> table = []
+    {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void appendBigEndian(std::vector<uint8_t>& out, uint32_t v)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back(uint8_t(v >> shift));
+}
+
+void writeChunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> chunk;
+    appendBigEndian(chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+    file.write((const char*)chunk.data(), chunk.size());
+}
+
+uint8_t linearToSrgb8(float v)
+{
+    v = saturate(v);
+    const float s = v <= 0.0031308f ? 12.92f * v : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+    return uint8_t(s * 255.0f + 0.5f);
+}
+} // namespace
+
+bool writePng(const std::string& path, const Image<float3>& image)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    // scanlines with filter type 0 (none)
+    std::vector<uint8_t> raw;
+    raw.reserve(size_t(image.width * 3 + 1) * image.height);
+    for (uint32_t y = 0; y < image.height; ++y)
+    {
+        raw.push_back(0);
+        for (uint32_t x = 0; x < image.width; ++x)
+        {
+            const float3& c = image(x, y);
+            raw.push_back(linearToSrgb8(c.x));
+            raw.push_back(linearToSrgb8(c.y));
+            raw.push_back(linearToSrgb8(c.z));
+        }
+    }
+
+    // zlib stream of stored deflate blocks: no compressor needed, the frames are for diffing
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    const size_t kMaxBlock = 65535;
+    for (size_t pos = 0; pos < raw.size() || pos == 0; pos += kMaxBlock)
+    {
+        const uint16_t len = uint16_t(std::min(kMaxBlock, raw.size() - pos));
+        zlib.push_back(pos + len >= raw.size() ? 1 : 0);
+        zlib.push_back(uint8_t(len));
+        zlib.push_back(uint8_t(len >> 8));
+        zlib.push_back(uint8_t(~len));
+        zlib.push_back(uint8_t(~len >> 8));
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+    }
+    uint32_t a = 1, b = 0;
+    for (uint8_t v : raw)
+    {
+        a = (a + v) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(zlib, (b << 16) | a);
+
+    static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    file.write((const char*)kSignature, sizeof(kSignature));
+    std::vector<uint8_t> header;
+    appendBigEndian(header, image.width);
+    appendBigEndian(header, image.height);
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8 bit RGB, deflate, no filter, no interlace
+    writeChunk(file, "IHDR", header);
+    writeChunk(file, "IDAT", zlib);
+    writeChunk(file, "IEND", {});
+    return bool(file);
+}
+
+HeightImage readPgm(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    file >> magic;
+    if (!file || magic != "P5")
+        return {};
+
+    // width, height and maxval, with # comments in between
+    uint32_t values[3] = {};
+    for (uint32_t& v : values)
+    {
+        file >> std::ws;
+        while (file.peek() == '#')
+        {
+            std::string comment;
+            std::getline(file, comment);
+            file >> std::ws;
+        }
+        file >> v;
+    }
+    file.get(); // the single whitespace before the samples
+    const uint32_t maxVal = values[2];
+    if (!file || values[0] == 0 || values[1] == 0 || maxVal == 0 || maxVal > 65535)
+        return {};
+
+    HeightImage heightmap(values[0], values[1]);
+    const size_t sampleBytes = maxVal < 256 ? 1 : 2;
+    std::vector<uint8_t> data(heightmap.texels.size() * sampleBytes);
+    file.read((char*)data.data(), data.size());
+    if (!file)
+        return {};
+    for (size_t i = 0; i < heightmap.texels.size(); ++i)
+    {
+        // samples are big endian, scaled to the full 16 bit range
+        const uint32_t v = sampleBytes == 1 ? data[i] : (uint32_t(data[2 * i]) << 8) | data[2 * i + 1];
+        heightmap.texels[i] = uint16_t((std::min(v, maxVal) * 65535u + maxVal / 2) / maxVal);
+    }
+    return heightmap;
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,12 @@
+#pragma once
+#include "Image.h"
+#include "Math.h"
+#include <string>
+
+namespace ParallaxCpu
+{
+// 8 bit sRGB PNG (stored, uncompressed) of linear colors, like a screen capture of the sRGB back buffer
+bool writePng(const std::string& path, const Image<float3>& image);
+// Binary PGM (P5) heightmap with 8 or 16 bit samples; empty on error
+HeightImage readPgm(const std::string& path);
+} // namespace ParallaxCpu
@@ -0,0 +1,43 @@
+#pragma once
+#include "Image.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ParallaxCpu
+{
+struct float3
+{
+    float x = 0, y = 0, z = 0;
+};
+
+// The few HLSL-like vector operations the CPU shader ports need
+inline float2 operator+(float2 a, float2 b) { return {a.x + b.x, a.y + b.y}; }
+inline float2 operator-(float2 a, float2 b) { return {a.x - b.x, a.y - b.y}; }
+inline float2 operator*(float2 a, float2 b) { return {a.x * b.x, a.y * b.y}; }
+inline float2 operator*(float2 a, float s) { return {a.x * s, a.y * s}; }
+inline float2 operator*(float s, float2 a) { return a * s; }
+inline float2 operator/(float2 a, float s) { return {a.x / s, a.y / s}; }
+inline float2 lerp(float2 a, float2 b, float t) { return a + (b - a) * t; }
+
+inline float3 operator+(float3 a, float3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline float3 operator-(float3 a, float3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline float3 operator-(float3 a) { return {-a.x, -a.y, -a.z}; }
+inline float3 operator*(float3 a, float3 b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
+inline float3 operator*(float3 a, float s) { return {a.x * s, a.y * s, a.z * s}; }
+inline float3 operator*(float s, float3 a) { return a * s; }
+inline float3 operator/(float3 a, float s) { return {a.x / s, a.y / s, a.z / s}; }
+inline float dot(float3 a, float3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float3 cross(float3 a, float3 b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+inline float length(float3 a) { return std::sqrt(dot(a, a)); }
+inline float3 normalize(float3 a) { return a / length(a); }
+inline float3 lerp(float3 a, float3 b, float t) { return a + (b - a) * t; }
+
+inline float saturate(float v) { return std::clamp(v, 0.0f, 1.0f); }
+
+// Rotation around a unit axis, like Falcor's rotate()
+inline float3 rotate(float3 v, float angle, float3 axis)
+{
+    const float c = std::cos(angle), s = std::sin(angle);
+    return c * v + s * cross(axis, v) + (1 - c) * dot(axis, v) * axis;
+}
+} // namespace ParallaxCpu
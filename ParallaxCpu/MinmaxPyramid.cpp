@@ -0,0 +1,266 @@
+#include "MinmaxPyramid.h"
+#include "Parallel.h"
+#include "Simd.h"
+#include <algorithm>
+#include <atomic>
+
+namespace ParallaxCpu
+{
+namespace
+{
+// Levels 1..kBlockLevels of a block are reduced in a local buffer (128x128 texels of level 0)
+constexpr uint32_t kBlockLevels = 7;
+constexpr uint32_t kBlockSize = 1u << kBlockLevels;
+
+inline uint16_t widen(uint16_t v) { return v; }
+inline uint16_t widen(uint8_t v) { return uint16_t(v * 257); }
+
+// Reduces the [min, max] source texels below the parents [xBegin, xEnd) of row y of a dstW x dstH
+// level into dstMin/dstMax[0, xEnd - xBegin). A parent covers 2x2 texels; the last parent of an odd
+// sized source row/column also covers the third texel (3-wide reduction), so no edge texel is dropped.
+// Whole 2x2 quads go through the SIMD reduction, kReduceWidth parents at a time.
+template<typename T>
+void reduceRow(const T* srcMin, const T* srcMax, size_t srcStride, uint32_t srcW, uint32_t srcH, uint32_t dstW, uint32_t dstH,
+               uint32_t y, uint32_t xBegin, uint32_t xEnd, uint16_t* dstMin, uint16_t* dstMax)
+{
+    // reads are clamped for 1 texel wide sources
+    const size_t row0 = std::min(2 * y + 0, srcH - 1) * srcStride;
+    const size_t row1 = std::min(2 * y + 1, srcH - 1) * srcStride;
+    const bool extraRow = y + 1 == dstH && srcH > 2 * dstH;
+    const bool extraCol = srcW > 2 * dstW;
+    uint32_t x = xBegin;
+    if (!extraRow)
+    {
+        const uint32_t quadEnd = std::min(xEnd, std::min(srcW / 2, extraCol ? dstW - 1 : dstW));
+        const uint32_t quads = x < quadEnd ? (quadEnd - x) / simd::kReduceWidth * simd::kReduceWidth : 0;
+        if (quads > 0)
+        {
+            PARALLAX_CPU_SIMD_CALL(simd::reduce2x2<false>, srcMin + row0 + 2 * x, srcMin + row1 + 2 * x, dstMin + (x - xBegin), quads);
+            PARALLAX_CPU_SIMD_CALL(simd::reduce2x2<true>, srcMax + row0 + 2 * x, srcMax + row1 + 2 * x, dstMax + (x - xBegin), quads);
+            x += quads;
+        }
+    }
+    for (; x < xEnd; ++x)
+    {
+        const size_t x0 = std::min(2 * x + 0, srcW - 1), x1 = std::min(2 * x + 1, srcW - 1);
+        const size_t x2 = extraCol && x + 1 == dstW ? 2 * x + 2 : x1;
+        auto rowMin = [&](size_t row) { return std::min(std::min(srcMin[row + x0], srcMin[row + x1]), srcMin[row + x2]); };
+        auto rowMax = [&](size_t row) { return std::max(std::max(srcMax[row + x0], srcMax[row + x1]), srcMax[row + x2]); };
+        T lo = std::min(rowMin(row0), rowMin(row1));
+        T hi = std::max(rowMax(row0), rowMax(row1));
+        if (extraRow)
+        {
+            lo = std::min(lo, rowMin((2 * y + 2) * srcStride));
+            hi = std::max(hi, rowMax((2 * y + 2) * srcStride));
+        }
+        dstMin[x - xBegin] = widen(lo);
+        dstMax[x - xBegin] = widen(hi);
+    }
+}
+
+// Level 0 has no min plane, its heights are both
+const uint16_t* minPlane(const MinmaxLevel& level)
+{
+    return level.minH.empty() ? level.maxH.data() : level.minH.data();
+}
+
+void reduceNodes(const MinmaxLevel& src, MinmaxLevel& dst, uint32_t y, uint32_t xBegin, uint32_t xEnd)
+{
+    reduceRow(minPlane(src), src.maxH.data(), src.width, src.width, src.height, dst.width, dst.height,
+              y, xBegin, xEnd, &dst.minH[dst.index(xBegin, y)], &dst.maxH[dst.index(xBegin, y)]);
+}
+
+void reduceLevel(const MinmaxLevel& src, MinmaxLevel& dst)
+{
+    for (uint32_t y = 0; y < dst.height; ++y)
+        reduceNodes(src, dst, y, 0, dst.width);
+}
+} // namespace
+
+void MinmaxLevel::resize(uint32_t w, uint32_t h, bool hasMin)
+{
+    width = w;
+    height = h;
+    minH.assign(hasMin ? size_t(w) * h + 1 : 0, 0);
+    maxH.assign(size_t(w) * h + 1, 0);
+}
+
+template<typename T>
+MinmaxPyramid MinmaxPyramid::buildFrom(const Image<T>& heightmap)
+{
+    MinmaxPyramid pyramid;
+    if (heightmap.empty())
+        return pyramid;
+
+    // same level count as a full mip chain
+    uint32_t levelCount = 1;
+    for (uint32_t s = std::max(heightmap.width, heightmap.height); s > 1; s /= 2)
+        ++levelCount;
+    pyramid.mLevels.resize(levelCount);
+    pyramid.mLevels[0].resize(heightmap.width, heightmap.height, false);
+    for (uint32_t level = 1; level < levelCount; ++level)
+    {
+        const MinmaxLevel& src = pyramid.mLevels[level - 1];
+        pyramid.mLevels[level].resize(std::max(1u, src.width / 2), std::max(1u, src.height / 2));
+    }
+
+    // One sweep in the spirit of AMD's FidelityFX SPD: every heightmap texel is read once and its
+    // ancestors up to kBlockLevels are reduced while the block is still in the cache.
+    // A node's 2x2 children never cross a block border, so this matches the level by level reduction.
+    // The block that finishes last reduces the few upper levels, so there is no second pass over the blocks.
+    const uint32_t blockLevels = std::min(kBlockLevels, levelCount - 1);
+    const uint32_t blocksX = (heightmap.width + kBlockSize - 1) / kBlockSize;
+    const uint32_t blocksY = (heightmap.height + kBlockSize - 1) / kBlockSize;
+    std::atomic<uint32_t> finishedBlocks{0};
+    parallelFor(0, blocksX * blocksY, [&](uint32_t block)
+    {
+        const uint32_t bx = block % blocksX, by = block / blocksX;
+        uint16_t localMin[2][kBlockSize * kBlockSize / 4];
+        uint16_t localMax[2][kBlockSize * kBlockSize / 4];
+
+        // level 0 is the heightmap itself (min = max)
+        MinmaxLevel& base = pyramid.mLevels[0];
+        const uint32_t x0 = bx * kBlockSize, y0 = by * kBlockSize;
+        uint32_t srcW = std::min(kBlockSize, base.width - x0), srcH = std::min(kBlockSize, base.height - y0);
+        for (uint32_t y = 0; y < srcH; ++y)
+        {
+            const T* src = &heightmap(x0, y0 + y);
+            std::transform(src, src + srcW, &base.maxH[base.index(x0, y0 + y)], [](T v) { return widen(v); });
+        }
+
+        // level 1 reads the source texels, the further levels the local buffers
+        const T* srcHeights = &heightmap(x0, y0);
+        const uint16_t* srcMin = nullptr;
+        const uint16_t* srcMax = nullptr;
+        size_t srcStride = heightmap.width;
+        for (uint32_t level = 1; level <= blockLevels; ++level)
+        {
+            MinmaxLevel& dst = pyramid.mLevels[level];
+            const uint32_t dstX0 = x0 >> level, dstY0 = y0 >> level;
+            // nodes of this block on the level; blocks past the end of a level are empty
+            const uint32_t dstW = std::min(kBlockSize >> level, dst.width - std::min(dst.width, dstX0));
+            const uint32_t dstH = std::min(kBlockSize >> level, dst.height - std::min(dst.height, dstY0));
+            if (dstW == 0 || dstH == 0)
+                break;
+            uint16_t* dstMin = localMin[level & 1];
+            uint16_t* dstMax = localMax[level & 1];
+            const size_t dstStride = kBlockSize >> level;
+            for (uint32_t y = 0; y < dstH; ++y)
+            {
+                uint16_t* rowMin = dstMin + y * dstStride;
+                uint16_t* rowMax = dstMax + y * dstStride;
+                if (level == 1)
+                    reduceRow(srcHeights, srcHeights, srcStride, srcW, srcH, dstW, dstH, y, 0, dstW, rowMin, rowMax);
+                else
+                    reduceRow(srcMin, srcMax, srcStride, srcW, srcH, dstW, dstH, y, 0, dstW, rowMin, rowMax);
+                std::copy(dstMin + y * dstStride, dstMin + y * dstStride + dstW, &dst.minH[dst.index(dstX0, dstY0 + y)]);
+                std::copy(dstMax + y * dstStride, dstMax + y * dstStride + dstW, &dst.maxH[dst.index(dstX0, dstY0 + y)]);
+            }
+            srcMin = dstMin;
+            srcMax = dstMax;
+            srcStride = dstStride;
+            srcW = dstW;
+            srcH = dstH;
+        }
+
+        // the last block sees the results of all the others (the counter orders the writes)
+        if (++finishedBlocks == blocksX * blocksY)
+        {
+            // The 3-wide edge of an odd level can lie in the next block, so the last row and column
+            // of the block levels are reduced again from the complete level below
+            for (uint32_t level = 1; level <= blockLevels; ++level)
+            {
+                const MinmaxLevel& src = pyramid.mLevels[level - 1];
+                MinmaxLevel& dst = pyramid.mLevels[level];
+                reduceNodes(src, dst, dst.height - 1, 0, dst.width);
+                for (uint32_t y = 0; y + 1 < dst.height; ++y)
+                    reduceNodes(src, dst, y, dst.width - 1, dst.width);
+            }
+            for (uint32_t level = blockLevels + 1; level < levelCount; ++level)
+                reduceLevel(pyramid.mLevels[level - 1], pyramid.mLevels[level]);
+        }
+    }, 1);
+    return pyramid;
+}
+
+uint32_t MinmaxPyramid::update(const HeightImage& heightmap, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    if (mLevels.empty() || heightmap.width != getWidth() || heightmap.height != getHeight())
+        return 0;
+    w = std::min(w, heightmap.width - std::min(x, heightmap.width));
+    h = std::min(h, heightmap.height - std::min(y, heightmap.height));
+    if (w == 0 || h == 0)
+        return 0;
+
+    // bounding box of the changed nodes on the current level, inclusive
+    uint32_t x0 = UINT32_MAX, y0 = UINT32_MAX, x1 = 0, y1 = 0;
+    auto markChanged = [&](uint32_t i, uint32_t j)
+    {
+        x0 = std::min(x0, i);
+        y0 = std::min(y0, j);
+        x1 = std::max(x1, i);
+        y1 = std::max(y1, j);
+    };
+
+    MinmaxLevel& base = mLevels[0];
+    for (uint32_t j = y; j < y + h; ++j)
+    {
+        for (uint32_t i = x; i < x + w; ++i)
+        {
+            uint16_t& dst = base.maxH[base.index(i, j)];
+            if (dst != heightmap(i, j))
+            {
+                dst = heightmap(i, j);
+                markChanged(i, j);
+            }
+        }
+    }
+
+    uint32_t changedLevels = 0;
+    std::vector<uint16_t> rowMin, rowMax;
+    for (uint32_t level = 1; x0 <= x1; ++level)
+    {
+        ++changedLevels;
+        if (level == getLevelCount())
+            break;
+        const MinmaxLevel& src = mLevels[level - 1];
+        MinmaxLevel& dst = mLevels[level];
+
+        // parents of the changed nodes; an odd last row/column belongs to the last parent
+        const uint32_t px0 = std::min(x0 / 2, dst.width - 1), py0 = std::min(y0 / 2, dst.height - 1);
+        const uint32_t px1 = std::min(x1 / 2, dst.width - 1), py1 = std::min(y1 / 2, dst.height - 1);
+        const uint32_t rowW = px1 - px0 + 1;
+        rowMin.resize(rowW);
+        rowMax.resize(rowW);
+
+        x0 = y0 = UINT32_MAX;
+        x1 = y1 = 0;
+        for (uint32_t j = py0; j <= py1; ++j)
+        {
+            reduceRow(minPlane(src), src.maxH.data(), src.width, src.width, src.height, dst.width, dst.height,
+                      j, px0, px1 + 1, rowMin.data(), rowMax.data());
+            for (uint32_t i = 0; i < rowW; ++i)
+            {
+                const size_t idx = dst.index(px0 + i, j);
+                if (dst.minH[idx] != rowMin[i] || dst.maxH[idx] != rowMax[i])
+                {
+                    dst.minH[idx] = rowMin[i];
+                    dst.maxH[idx] = rowMax[i];
+                    markChanged(px0 + i, j);
+                }
+            }
+        }
+    }
+    return changedLevels;
+}
+
+MinmaxPyramid MinmaxPyramid::build(const HeightImage& heightmap)
+{
+    return buildFrom(heightmap);
+}
+
+MinmaxPyramid MinmaxPyramid::build(const Image<uint8_t>& heightmap)
+{
+    return buildFrom(heightmap);
+}
+} // namespace ParallaxCpu
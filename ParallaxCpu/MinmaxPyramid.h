@@ -0,0 +1,51 @@
+#pragma once
+#include "Image.h"
+
+namespace ParallaxCpu
+{
+// One level of the min-max pyramid, stored as two planes of 16 bit unorm heights.
+// Both planes carry one texel of padding after the last row so that 16 bit
+// values can be gathered with 32 bit loads.
+// Level 0 holds the heights in maxH only (min = max there), its minH is empty.
+struct MinmaxLevel
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint16_t> minH;
+    std::vector<uint16_t> maxH;
+
+    void resize(uint32_t w, uint32_t h, bool hasMin = true);
+    size_t index(uint32_t x, uint32_t y) const { return size_t(y) * width + x; }
+};
+
+// CPU counterpart of the height pyramid built by HeightPyramid.cs.slang (.r and .b channels):
+// level 0 holds the heights, every further level the [min, max] of the 2x2 texels below.
+// Level sizes are halved and rounded down like a mip chain; the last node of a level below an
+// odd size also covers the third row/column, so every node covers all texels of its region.
+// All levels are built in one sweep over blocks of the heightmap with SIMD 2x2 reductions.
+class MinmaxPyramid
+{
+public:
+    static MinmaxPyramid build(const HeightImage& heightmap);
+    // R8 heightmaps are reduced at 8 bits and stored widened to 16 bit unorm (v * 257)
+    static MinmaxPyramid build(const Image<uint8_t>& heightmap);
+
+    // Refreshes the pyramid after the heightmap texels in [x, x + w) x [y, y + h) were edited.
+    // Only the ancestors of the changed texels are recomputed, level by level, and the walk stops
+    // at the first level where no node changed: O(area of the edit + log N) instead of a rebuild.
+    // heightmap has to be the edited version of the one the pyramid was built from.
+    // Returns the number of levels that had changed nodes (0: the region was unchanged).
+    uint32_t update(const HeightImage& heightmap, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+
+    uint32_t getLevelCount() const { return (uint32_t)mLevels.size(); }
+    const MinmaxLevel& getLevel(uint32_t level) const { return mLevels[level]; }
+    uint32_t getWidth() const { return mLevels.empty() ? 0 : mLevels[0].width; }
+    uint32_t getHeight() const { return mLevels.empty() ? 0 : mLevels[0].height; }
+
+private:
+    template<typename T>
+    static MinmaxPyramid buildFrom(const Image<T>& heightmap);
+
+    std::vector<MinmaxLevel> mLevels;
+};
+} // namespace ParallaxCpu
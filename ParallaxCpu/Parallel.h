@@ -0,0 +1,48 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace ParallaxCpu
+{
+// Number of worker threads used by parallelFor (including the calling thread)
+inline uint32_t getWorkerCount()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls body(i) for every i in [begin, end) on all cores.
+// Work is handed out dynamically in chunks of `grain` indices, so uneven
+// per-index costs (e.g. texel rows near a tall peak) are balanced automatically.
+template<typename F>
+void parallelFor(uint32_t begin, uint32_t end, F&& body, uint32_t grain = 1)
+{
+    if (begin >= end)
+        return;
+    grain = std::max(1u, grain);
+    const uint32_t chunkCount = (end - begin + grain - 1) / grain;
+    const uint32_t threadCount = std::min(getWorkerCount(), chunkCount);
+
+    std::atomic<uint32_t> nextChunk{0};
+    auto worker = [&]()
+    {
+        for (uint32_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+        {
+            const uint32_t first = begin + chunk * grain;
+            const uint32_t last = std::min(end, first + grain);
+            for (uint32_t i = first; i < last; ++i)
+                body(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (uint32_t t = 1; t < threadCount; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads)
+        t.join();
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,96 @@
+#include "ProceduralHeight.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ParallaxCpu
+{
+namespace
+{
+// kSincLipschitz of ProceduralHeight.slang
+const float kSincLipschitz = 10.54f;
+
+float sincHeight(float2 t)
+{
+    const float x = 10 * t.x - 5, y = 10 * t.y - 5;
+    const float len2 = x * x + y * y;
+    return 0.8f * std::sin(len2) / len2 + 0.2f;
+}
+float sincMaxHeight(float2 lo, float2 hi)
+{
+    const float dx = hi.x - lo.x, dy = hi.y - lo.y;
+    const float lipschitz = sincHeight({0.5f * (lo.x + hi.x), 0.5f * (lo.y + hi.y)}) + kSincLipschitz * 0.5f * std::sqrt(dx * dx + dy * dy);
+    const float px = std::max({0.5f - hi.x, lo.x - 0.5f, 0.0f}) * 10, py = std::max({0.5f - hi.y, lo.y - 0.5f, 0.0f}) * 10;
+    const float s = px * px + py * py;
+    return std::min(lipschitz, s > 1 ? 0.8f / s + 0.2f : 1.0f);
+}
+
+float sphereProfile(float r, float len2)
+{
+    return 1 - r + (len2 >= r * r ? 0 : std::sqrt(r * r - len2));
+}
+float spheresHeight(const ProceduralHeightSettings& settings, float2 t)
+{
+    const float n = float(settings.intParams[0]);
+    const float x = 2 * std::fmod(t.x * n, 1.0f) - 1, y = 2 * std::fmod(t.y * n, 1.0f) - 1;
+    return sphereProfile(settings.floatParams[0], x * x + y * y);
+}
+// the distance from [lo, hi] to the nearest (i + 0.5) / n
+float centerDistance(float lo, float hi, float n)
+{
+    const float below = std::floor(lo * n - 0.5f);
+    return std::max(std::min(lo - (below + 0.5f) / n, (below + 1.5f) / n - hi), 0.0f);
+}
+float spheresMaxHeight(const ProceduralHeightSettings& settings, float2 lo, float2 hi)
+{
+    const float n = float(std::max(settings.intParams[0], 1));
+    const float dx = centerDistance(lo.x, hi.x, n), dy = centerDistance(lo.y, hi.y, n);
+    return sphereProfile(settings.floatParams[0], (dx * dx + dy * dy) * 4 * n * n);
+}
+
+bool inEdge(const ProceduralHeightSettings& settings, float lo, float hi)
+{
+    return !(hi < 0.5f - 1.0f / settings.width || lo > 0.5f);
+}
+bool inDot(const ProceduralHeightSettings& settings, float2 lo, float2 hi)
+{
+    return inEdge(settings, lo.x, hi.x) && !(hi.y < 0.5f - 1.0f / settings.height || lo.y > 0.5f);
+}
+} // namespace
+
+float proceduralHeight(const ProceduralHeightSettings& settings, float2 t)
+{
+    switch (settings.heightFun)
+    {
+    case 1: return spheresHeight(settings, t);
+    case 2: return inEdge(settings, t.x, t.x) ? 1.0f : 0.0f;
+    case 3: return inDot(settings, t, t) ? 1.0f : 0.0f;
+    default: return sincHeight(t);
+    }
+}
+
+float proceduralMaxHeight(const ProceduralHeightSettings& settings, float2 lo, float2 hi)
+{
+    switch (settings.heightFun)
+    {
+    case 1: return spheresMaxHeight(settings, lo, hi);
+    case 2: return inEdge(settings, lo.x, hi.x) ? 1.0f : 0.0f;
+    case 3: return inDot(settings, lo, hi) ? 1.0f : 0.0f;
+    default: return sincMaxHeight(lo, hi);
+    }
+}
+
+HeightImage generateProceduralHeightmap(const ProceduralHeightSettings& settings)
+{
+    HeightImage heightmap(settings.width, settings.height);
+    parallelFor(0, settings.height, [&](uint32_t y)
+    {
+        for (uint32_t x = 0; x < settings.width; ++x)
+        {
+            const float h = proceduralHeight(settings, {(x + 0.5f) / settings.width, (y + 0.5f) / settings.height});
+            heightmap(x, y) = (uint16_t)std::lround(std::clamp(h, 0.0f, 1.0f) * 65535.0f);
+        }
+    });
+    return heightmap;
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,23 @@
+#pragma once
+#include "Image.h"
+#include <array>
+
+namespace ParallaxCpu
+{
+// The CScb constants of ProceduralHeightmap.cs.slang, the procedural FScb constants of PARALLAX_FUN 14
+struct ProceduralHeightSettings
+{
+    uint32_t heightFun = 0;                      // HEIGHT_FUN: 0 sinc, 1 spheres, 2 edge, 3 dot
+    uint32_t width = 512, height = 512;          // the size of the generated heightmap
+    std::array<int32_t, 4> intParams = {5, 0, 0, 0}; // x: number of hemispheres in a row
+    std::array<float, 4> floatParams = {1, 0, 0, 0}; // x: relative radius of the hemispheres
+};
+
+// CPU port of proceduralH in ProceduralHeight.slang
+float proceduralHeight(const ProceduralHeightSettings& settings, float2 t);
+// CPU port of proceduralMaxH: an upper bound of the height over the uv rectangle [lo, hi]
+float proceduralMaxHeight(const ProceduralHeightSettings& settings, float2 lo, float2 hi);
+
+// CPU port of ProceduralHeightmap.cs.slang: the function at the texel centers of a width x height map
+HeightImage generateProceduralHeightmap(const ProceduralHeightSettings& settings);
+} // namespace ParallaxCpu
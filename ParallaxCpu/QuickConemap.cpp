@@ -0,0 +1,89 @@
+#include "QuickConemap.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#define PARALLAX_CPU_SIMD_KERNELS "QuickConemapSimd.inl"
+#include "SimdKernels.h"
+
+namespace ParallaxCpu
+{
+namespace
+{
+constexpr uint32_t kTileSize = 64;
+} // namespace
+
+ConeImage generateQuickConemap(const QuickConemapSettings& settings, const MinmaxPyramid& pyramid)
+{
+    const uint32_t w = pyramid.getWidth();
+    const uint32_t h = pyramid.getHeight();
+    ConeImage coneMap(w, h);
+    if (w == 0 || h == 0)
+        return coneMap;
+
+    // the last level with more than one virtual node; for NPOT sizes this can be the real 1x1 level
+    uint32_t maxLevel = 0;
+    while ((2u << maxLevel) < std::max(w, h))
+        ++maxLevel;
+
+    // Texels are visited in tiles instead of whole rows, so the nodes around a tile (and their
+    // neighbours on every level) stay in the cache while all packets of the tile are processed
+    const uint32_t tilesX = (w + kTileSize - 1) / kTileSize;
+    const uint32_t tilesY = (h + kTileSize - 1) / kTileSize;
+    parallelFor(0, tilesX * tilesY, [&](uint32_t tile)
+    {
+        const uint32_t tileX = (tile % tilesX) * kTileSize;
+        const uint32_t tileY = (tile / tilesX) * kTileSize;
+        const uint32_t tileEndX = std::min(tileX + kTileSize, w);
+        const uint32_t tileEndY = std::min(tileY + kTileSize, h);
+        PARALLAX_CPU_SIMD_CALL(quickConeTile, settings, pyramid, maxLevel, tileX, tileY, tileEndX, tileEndY, coneMap);
+    }, 1);
+    return coneMap;
+}
+
+ConeImage generateQuickConemap(const QuickConemapSettings& settings, const HeightImage& heightmap)
+{
+    return generateQuickConemap(settings, MinmaxPyramid::build(heightmap));
+}
+
+uint32_t countNonConservativeTexels(const HeightImage& heightmap, const ConeImage& coneMap, float* pWorstRatio)
+{
+    const uint32_t w = heightmap.width, h = heightmap.height;
+    std::vector<uint32_t> rowCounts(h, 0);
+    std::vector<float> rowRatios(h, 1.0f);
+    parallelFor(0, h, [&](uint32_t y)
+    {
+        for (uint32_t x = 0; x < w; ++x)
+        {
+            const float baseH = unorm16ToFloat(heightmap(x, y));
+            const float coneTan = coneMap(x, y).y;
+            // only the texels within coneTan * (1 - baseH) in uv can be inside the cone
+            const float reach = coneTan * (1.0f - baseH);
+            const int32_t rx = (int32_t)std::ceil(reach * w), ry = (int32_t)std::ceil(reach * h);
+            float exactTan = coneTan;
+            for (int32_t ny = std::max(0, (int32_t)y - ry); ny <= std::min((int32_t)h - 1, (int32_t)y + ry); ++ny)
+            {
+                for (int32_t nx = std::max(0, (int32_t)x - rx); nx <= std::min((int32_t)w - 1, (int32_t)x + rx); ++nx)
+                {
+                    const float heightDiff = unorm16ToFloat(heightmap(nx, ny)) - baseH;
+                    if (heightDiff <= 0)
+                        continue;
+                    const float du = float(nx - (int32_t)x) / w, dv = float(ny - (int32_t)y) / h;
+                    exactTan = std::min(exactTan, std::sqrt(du * du + dv * dv) / heightDiff);
+                }
+            }
+            // tolerate the rounding of the float distances
+            if (exactTan < coneTan * (1.0f - 1e-5f))
+            {
+                ++rowCounts[y];
+                rowRatios[y] = std::min(rowRatios[y], exactTan / coneTan);
+            }
+        }
+    });
+    if (pWorstRatio)
+        *pWorstRatio = *std::min_element(rowRatios.begin(), rowRatios.end());
+    return std::accumulate(rowCounts.begin(), rowCounts.end(), 0u);
+}
+} // namespace ParallaxCpu
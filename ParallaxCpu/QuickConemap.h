@@ -0,0 +1,31 @@
+#pragma once
+#include "Image.h"
+#include "MinmaxPyramid.h"
+
+namespace ParallaxCpu
+{
+// Values match QUICK_GEN_ALG in QuickConemap.cs.slang
+enum class QuickConemapAlgorithm : uint32_t
+{
+    Naive = 1,
+    RegionGrowing3x3 = 2,
+    RegionGrowing5x5 = 3,
+    RegionGrowing7x7 = 4,
+};
+
+struct QuickConemapSettings
+{
+    QuickConemapAlgorithm algorithm = QuickConemapAlgorithm::RegionGrowing3x3;
+    bool maxAtTexelCenter = false; // MAX_AT_TEXEL_CENTER
+};
+
+// CPU port of QuickConemap.cs.slang: creates a conservative cone map from the min-max pyramid.
+// Tiles of texels are spread over all cores and processed in packets of simd::kLanes neighbouring texels.
+ConeImage generateQuickConemap(const QuickConemapSettings& settings, const MinmaxPyramid& pyramid);
+// Builds the whole pyramid, then runs the tiled bake on it: the cones of a tile need the upper levels
+ConeImage generateQuickConemap(const QuickConemapSettings& settings, const HeightImage& heightmap);
+
+// Brute-force check of a cone map against the heights at the texel centers: counts the texels whose cone
+// contains a higher texel center. pWorstRatio: the smallest ratio of the exact cone tan to the stored one.
+uint32_t countNonConservativeTexels(const HeightImage& heightmap, const ConeImage& coneMap, float* pWorstRatio = nullptr);
+} // namespace ParallaxCpu
@@ -0,0 +1,353 @@
+// The kernels of the quick cone map bake (QuickConemap.cpp), compiled per SIMD backend by SimdKernels.h
+namespace
+{
+using namespace simd;
+
+constexpr float kUnorm16 = 1.0f / 65535.0f;
+constexpr int32_t kMaxRingRadius = 3;
+
+// A row packet of texels and the pyramid node containing each of them on the current level.
+// Nodes are indexed on a virtual power of two grid (node i covers texels [i * 2^level, (i + 1) * 2^level)),
+// so NPOT sizes keep the same node geometry. Nodes past the real level are read from its last node,
+// which also covers the texels of the odd edges (see MinmaxPyramid).
+struct Packet
+{
+    vint baseX;    // texel column of each lane (clamped into the texture for inactive lanes)
+    vfloat baseH;  // apex height
+    vfloat minTan; // result so far
+    vfloat baseU;  // texel center texture coordinates
+    float baseV = 0;
+
+    const MinmaxLevel* level = nullptr;
+    int32_t nodesX = 0; // virtual node count of the current level
+    int32_t nodesY = 0;
+    vint ijX;          // node column of each lane on the current level
+    int32_t ijY = 0;   // node row (the same for all lanes)
+    int32_t ijX0 = 0;  // node column of the first lane
+    bool uniformX = false; // all lanes are in the same node
+};
+
+void checkNeighbour(Packet& p, int32_t dx, int32_t dy, vmask cond, vfloat dist)
+{
+    if (none(cond))
+        return;
+    const MinmaxLevel& lvl = *p.level;
+    const int32_t maxX = (int32_t)lvl.width - 1;
+    const size_t rowOffset = size_t(std::min(p.ijY + dy, (int32_t)lvl.height - 1)) * lvl.width;
+    vfloat nMaxHeight;
+    if (p.uniformX)
+        nMaxHeight = vfloat(float(lvl.maxH[rowOffset + std::min(p.ijX0 + dx, maxX)]) * kUnorm16);
+    else
+        nMaxHeight = toFloat(gatherU16(lvl.maxH.data() + rowOffset, min(p.ijX + vint(dx), vint(maxX)), cond)) * vfloat(kUnorm16);
+    const vfloat heightDiff = nMaxHeight - p.baseH;
+    const vmask m = cond & (heightDiff > dist);
+    p.minTan = select(m, min(p.minTan, dist / heightDiff), p.minTan);
+}
+
+vfloat length(vfloat x, vfloat y)
+{
+    return sqrt(x * x + y * y);
+}
+
+// The distance of the nearest child of a diagonal node that was not checked on the previous level. When the last
+// node is in the corner next to the diagonal node, the three children of the diagonal node that touch it on the
+// sides were not checked either, and the nearer of them can lie on either side.
+vfloat calcNearestUncheckedDiagonalDist(vmask isSpecX, vmask isSpecY, vfloat distX, vfloat distY, float2 delta)
+{
+    const vfloat sx = select(isSpecX, distX - vfloat(delta.x), distX);
+    const vfloat sy = select(isSpecY, distY - vfloat(delta.y), distY);
+    return select(isSpecX & isSpecY, min(length(distX, sy), length(sx, distY)), length(sx, sy));
+}
+
+void setLevel(Packet& p, const MinmaxPyramid& pyramid, uint32_t level, int32_t x0, int32_t xLast, int32_t y)
+{
+    p.level = &pyramid.getLevel(level);
+    p.nodesX = int32_t((pyramid.getWidth() + (1u << level) - 1) >> level);
+    p.nodesY = int32_t((pyramid.getHeight() + (1u << level) - 1) >> level);
+    p.ijX = p.baseX >> (int)level;
+    p.ijX0 = x0 >> level;
+    p.ijY = y >> level;
+    p.uniformX = p.ijX0 == (xLast >> level);
+}
+
+// Size of the virtual grid of a level in nodes, 2^level texels per node
+float2 virtualLevelSize(const MinmaxPyramid& pyramid, uint32_t level)
+{
+    const float scale = 1.0f / float(1u << level);
+    return {pyramid.getWidth() * scale, pyramid.getHeight() * scale};
+}
+
+// Checks the 8 neighbours of the current nodes with the given distances to their nearest points
+// left/top/right/bottom; diagonals are given separately
+void checkRing(Packet& p, vfloat distL, vfloat distT, vfloat distR, vfloat distB, vfloat distTL, vfloat distTR, vfloat distBR, vfloat distBL)
+{
+    const vmask hasLeft = p.ijX > vint(0);
+    const vmask hasRight = p.ijX < vint(p.nodesX - 1);
+    const vmask hasTop = vmask(p.ijY > 0);
+    const vmask hasBottom = vmask(p.ijY < p.nodesY - 1);
+
+    // orthogonal neighbours
+    checkNeighbour(p, -1, 0, hasLeft, distL);
+    checkNeighbour(p, +1, 0, hasRight, distR);
+    checkNeighbour(p, 0, -1, hasTop, distT);
+    checkNeighbour(p, 0, +1, hasBottom, distB);
+    // diagonal neighbours
+    checkNeighbour(p, -1, -1, hasLeft & hasTop, distTL);
+    checkNeighbour(p, +1, -1, hasRight & hasTop, distTR);
+    checkNeighbour(p, +1, +1, hasRight & hasBottom, distBR);
+    checkNeighbour(p, -1, +1, hasLeft & hasBottom, distBL);
+}
+
+// see generateQuickConeMap_naive in QuickConemap.cs.slang
+void quickConeNaive(Packet& p, const MinmaxPyramid& pyramid, uint32_t maxLevel, bool maxAtTexelCenter, int32_t x0, int32_t xLast, int32_t y)
+{
+    const float2 deltaHalf = {0.5f / pyramid.getWidth(), 0.5f / pyramid.getHeight()};
+    float2 currDeltaHalf = deltaHalf;
+    vfloat distL = 2 * deltaHalf.x, distR = 2 * deltaHalf.x;
+    vfloat distT = 2 * deltaHalf.y, distB = 2 * deltaHalf.y;
+
+    for (uint32_t currLevel = 0; currLevel <= maxLevel; ++currLevel)
+    {
+        setLevel(p, pyramid, currLevel, x0, xLast, y);
+        checkRing(p, distL, distT, distR, distB, length(distL, distT), length(distR, distT), length(distR, distB), length(distL, distB));
+
+        // the nodes on the next level
+        const float2 nextSize = virtualLevelSize(pyramid, currLevel + 1);
+        currDeltaHalf.x *= 2;
+        currDeltaHalf.y *= 2;
+        const vfloat currRelativeX = p.baseU - (toFloat(p.baseX >> (int)(currLevel + 1)) + vfloat(0.5f)) / vfloat(nextSize.x);
+        const float currRelativeY = p.baseV - (float(y >> (currLevel + 1)) + 0.5f) / nextSize.y;
+        const float2 pad = maxAtTexelCenter ? currDeltaHalf : deltaHalf;
+        distL = vfloat(currDeltaHalf.x + pad.x) + currRelativeX;
+        distR = vfloat(currDeltaHalf.x + pad.x) - currRelativeX;
+        distT = vfloat(currDeltaHalf.y + pad.y + currRelativeY);
+        distB = vfloat(currDeltaHalf.y + pad.y - currRelativeY);
+    }
+}
+
+// see generateQuickConeMap_regionGrowing3x3 in QuickConemap.cs.slang
+void quickConeRegionGrowing3x3(Packet& p, const MinmaxPyramid& pyramid, uint32_t maxLevel, bool maxAtTexelCenter, int32_t x0, int32_t xLast, int32_t y)
+{
+    const float2 deltaHalf = {0.5f / pyramid.getWidth(), 0.5f / pyramid.getHeight()};
+    float2 currDeltaHalf = deltaHalf;
+
+    // first step is the 8 neighbour
+    {
+        setLevel(p, pyramid, 0, x0, xLast, y);
+        const vfloat dx = 2 * deltaHalf.x, dy = 2 * deltaHalf.y;
+        const vfloat diag = length(dx, dy);
+        checkRing(p, dx, dy, dx, dy, diag, diag, diag, diag);
+    }
+
+    vfloat currRelativeX = 0.0f;
+    float currRelativeY = 0.0f;
+    for (uint32_t currLevel = 1; currLevel <= maxLevel; ++currLevel)
+    {
+        const vint lastIJX = p.ijX;
+        const int32_t lastIJY = p.ijY;
+        const vfloat lastRelativeX = currRelativeX;
+        const float lastRelativeY = currRelativeY;
+
+        setLevel(p, pyramid, currLevel, x0, xLast, y);
+        const float2 currSize = virtualLevelSize(pyramid, currLevel);
+        currRelativeX = p.baseU - (toFloat(p.ijX) + vfloat(0.5f)) / vfloat(currSize.x);
+        currRelativeY = p.baseV - (float(p.ijY) + 0.5f) / currSize.y;
+
+        vfloat distL, distT, distR, distB;
+        if (maxAtTexelCenter)
+        {
+            distL = vfloat(4 * currDeltaHalf.x) + currRelativeX;
+            distR = vfloat(4 * currDeltaHalf.x) - currRelativeX;
+            distT = vfloat(4 * currDeltaHalf.y + currRelativeY);
+            distB = vfloat(4 * currDeltaHalf.y - currRelativeY);
+        }
+        else
+        {
+            distL = vfloat(3 * currDeltaHalf.x + deltaHalf.x) + lastRelativeX;
+            distR = vfloat(3 * currDeltaHalf.x + deltaHalf.x) - lastRelativeX;
+            distT = vfloat(3 * currDeltaHalf.y + lastRelativeY + deltaHalf.y);
+            distB = vfloat(3 * currDeltaHalf.y - lastRelativeY + deltaHalf.y);
+        }
+        currDeltaHalf.x *= 2;
+        currDeltaHalf.y *= 2;
+
+        vfloat distTL, distTR, distBR, distBL;
+        if (maxAtTexelCenter)
+        {
+            distTL = length(distL, distT);
+            distTR = length(distR, distT);
+            distBR = length(distR, distB);
+            distBL = length(distL, distB);
+        }
+        else
+        {
+            // position of the last node inside the current one
+            const vmask lastOddX = (lastIJX & vint(1)) == vint(1);
+            const vmask lastOddY = vmask((lastIJY & 1) == 1);
+            distTL = calcNearestUncheckedDiagonalDist(!lastOddX, !lastOddY, distL, distT, currDeltaHalf);
+            distTR = calcNearestUncheckedDiagonalDist(lastOddX, !lastOddY, distR, distT, currDeltaHalf);
+            distBR = calcNearestUncheckedDiagonalDist(lastOddX, lastOddY, distR, distB, currDeltaHalf);
+            distBL = calcNearestUncheckedDiagonalDist(!lastOddX, lastOddY, distL, distB, currDeltaHalf);
+        }
+        checkRing(p, distL, distT, distR, distB, distTL, distTR, distBR, distBL);
+    }
+}
+// see generateQuickConeMap_regionGrowingRing in QuickConemap.cs.slang
+// Checks a (2r+1)x(2r+1) window of nodes on every level. The distance of a node is the distance of
+// its nearest child (on the previous level) that was outside the previous window, which is the
+// generalization of calcNearestUncheckedDiagonalDist to any ring size.
+void quickConeRegionGrowingRing(Packet& p, const MinmaxPyramid& pyramid, uint32_t maxLevel, bool maxAtTexelCenter, int32_t r, int32_t x0, int32_t xLast, int32_t y)
+{
+    const float2 texelSize = {1.0f / pyramid.getWidth(), 1.0f / pyramid.getHeight()};
+    const MinmaxLevel& root = pyramid.getLevel(pyramid.getLevelCount() - 1);
+    const vfloat rootMax = float(root.maxH[0]) * kUnorm16;
+    // texel center of the apex in texel units
+    const vfloat baseTX = toFloat(p.baseX) + vfloat(0.5f);
+    const float baseTY = float(y) + 0.5f;
+
+    // level 0: every texel of the window
+    setLevel(p, pyramid, 0, x0, xLast, y);
+    for (int32_t dy = -r; dy <= r; ++dy)
+    {
+        const bool rowInside = p.ijY + dy >= 0 && p.ijY + dy < p.nodesY;
+        for (int32_t dx = -r; dx <= r; ++dx)
+        {
+            if (!rowInside || (dx == 0 && dy == 0))
+                continue;
+            const vmask cond = (p.ijX + vint(dx) >= vint(0)) & (p.ijX + vint(dx) < vint(p.nodesX));
+            checkNeighbour(p, dx, dy, cond, vfloat(std::sqrt(dx * texelSize.x * dx * texelSize.x + dy * texelSize.y * dy * texelSize.y)));
+        }
+    }
+
+    const int32_t span = 4 * r + 2; // children columns/rows covered by the window
+    vfloat childDistX2[4 * kMaxRingRadius + 2];
+    vmask childOutsideX[4 * kMaxRingRadius + 2];
+    float childDistY2[4 * kMaxRingRadius + 2];
+    bool childOutsideY[4 * kMaxRingRadius + 2];
+
+    for (uint32_t currLevel = 1; currLevel <= maxLevel; ++currLevel)
+    {
+        const vint lastIJX = p.ijX;
+        const int32_t lastIJY = p.ijY;
+        const int32_t lastW = p.nodesX;
+        const int32_t lastH = p.nodesY;
+        const float s = float(1u << (currLevel - 1)); // size of the last nodes in texels
+
+        // early out: nothing outside the last window can narrow the cones any more
+        {
+            const float kFar = 1e10f;
+            const vfloat dL = select(lastIJX - vint(r) > vint(0), (baseTX - toFloat(lastIJX - vint(r)) * vfloat(s) + vfloat(0.5f)) * vfloat(texelSize.x), vfloat(kFar));
+            const vfloat dR = select(lastIJX + vint(r + 1) < vint(lastW), (toFloat(lastIJX + vint(r + 1)) * vfloat(s) + vfloat(0.5f) - baseTX) * vfloat(texelSize.x), vfloat(kFar));
+            const float dT = lastIJY - r > 0 ? (baseTY - (lastIJY - r) * s + 0.5f) * texelSize.y : kFar;
+            const float dB = lastIJY + r + 1 < lastH ? ((lastIJY + r + 1) * s + 0.5f - baseTY) * texelSize.y : kFar;
+            const vfloat minDist = min(min(dL, dR), vfloat(std::min(dT, dB)));
+            if (all(minDist >= p.minTan * (rootMax - p.baseH)))
+                break;
+        }
+
+        setLevel(p, pyramid, currLevel, x0, xLast, y);
+        const int32_t w = p.nodesX;
+        const int32_t h = p.nodesY;
+
+        // separable distances of the children columns and rows of the window
+        for (int32_t j = 0; j < span; ++j)
+        {
+            const vint c = (p.ijX - vint(r)) * vint(2) + vint(j);
+            const vfloat lo = toFloat(c) * vfloat(s) + vfloat(0.5f);
+            const vfloat hi = toFloat(c + vint(1)) * vfloat(s) - vfloat(0.5f);
+            const vfloat d = max(max(lo - baseTX, baseTX - hi), vfloat(0.0f)) * vfloat(texelSize.x);
+            childDistX2[j] = d * d;
+            childOutsideX[j] = (c < lastIJX - vint(r)) | (c > lastIJX + vint(r));
+
+            const int32_t cy = (p.ijY - r) * 2 + j;
+            const float dy = std::max(std::max(cy * s + 0.5f - baseTY, baseTY - ((cy + 1) * s - 0.5f)), 0.0f) * texelSize.y;
+            childDistY2[j] = dy * dy;
+            childOutsideY[j] = cy < lastIJY - r || cy > lastIJY + r;
+        }
+
+        for (int32_t dy = -r; dy <= r; ++dy)
+        {
+            const int32_t ny = p.ijY + dy;
+            if (ny < 0 || ny >= h)
+                continue;
+            const int32_t k = 2 * (dy + r);
+            for (int32_t dx = -r; dx <= r; ++dx)
+            {
+                // these are always inside the last window
+                if (2 * std::abs(dx) + 1 <= r && 2 * std::abs(dy) + 1 <= r)
+                    continue;
+                const int32_t j = 2 * (dx + r);
+                const vint nx = p.ijX + vint(dx);
+                vmask cond = (nx >= vint(0)) & (nx < vint(w));
+
+                const float kNone = 1e20f;
+                vfloat dist2 = kNone;
+                for (int32_t b = 0; b < 2; ++b)
+                {
+                    for (int32_t a = 0; a < 2; ++a)
+                    {
+                        const vmask unchecked = childOutsideX[j + a] | vmask(childOutsideY[k + b]);
+                        dist2 = select(unchecked, min(dist2, childDistX2[j + a] + vfloat(childDistY2[k + b])), dist2);
+                    }
+                }
+                cond = cond & (dist2 < vfloat(kNone));
+
+                vfloat dist;
+                if (maxAtTexelCenter)
+                {
+                    const float nodeSize = 2 * s;
+                    const vfloat cx = ((toFloat(nx) + vfloat(0.5f)) * vfloat(nodeSize) - baseTX) * vfloat(texelSize.x);
+                    const float cy = ((float(ny) + 0.5f) * nodeSize - baseTY) * texelSize.y;
+                    dist = length(cx, vfloat(cy));
+                }
+                else
+                    dist = sqrt(dist2);
+                checkNeighbour(p, dx, dy, cond, dist);
+            }
+        }
+    }
+}
+} // namespace
+
+// The cones of the texels [tileX, tileEndX) x [tileY, tileEndY), from the pyramid levels up to maxLevel
+void quickConeTile(const QuickConemapSettings& settings, const MinmaxPyramid& pyramid, uint32_t maxLevel, uint32_t tileX, uint32_t tileY,
+                   uint32_t tileEndX, uint32_t tileEndY, ConeImage& coneMap)
+{
+    const uint32_t w = pyramid.getWidth(), h = pyramid.getHeight();
+    const MinmaxLevel& base = pyramid.getLevel(0);
+    for (uint32_t y = tileY; y < tileEndY; ++y)
+    {
+        for (uint32_t x0 = tileX; x0 < tileEndX; x0 += kLanes)
+        {
+            const int32_t xLast = (int32_t)std::min(x0 + kLanes, tileEndX) - 1;
+            Packet p;
+            p.baseX = min(vint::iota((int32_t)x0), vint(xLast));
+            p.baseU = (toFloat(p.baseX) + vfloat(0.5f)) / vfloat((float)w);
+            p.baseV = (float(y) + 0.5f) / h;
+            p.baseH = toFloat(gatherU16(base.maxH.data() + base.index(0, y), p.baseX, vmask(true))) * vfloat(kUnorm16);
+            p.minTan = 1.0f;
+
+            switch (settings.algorithm)
+            {
+            case QuickConemapAlgorithm::Naive:
+                quickConeNaive(p, pyramid, maxLevel, settings.maxAtTexelCenter, (int32_t)x0, xLast, (int32_t)y);
+                break;
+            case QuickConemapAlgorithm::RegionGrowing3x3:
+                quickConeRegionGrowing3x3(p, pyramid, maxLevel, settings.maxAtTexelCenter, (int32_t)x0, xLast, (int32_t)y);
+                break;
+            case QuickConemapAlgorithm::RegionGrowing5x5:
+                quickConeRegionGrowingRing(p, pyramid, maxLevel, settings.maxAtTexelCenter, 2, (int32_t)x0, xLast, (int32_t)y);
+                break;
+            case QuickConemapAlgorithm::RegionGrowing7x7:
+                quickConeRegionGrowingRing(p, pyramid, maxLevel, settings.maxAtTexelCenter, 3, (int32_t)x0, xLast, (int32_t)y);
+                break;
+            }
+
+            float baseH[kLanes], minTan[kLanes];
+            p.baseH.store(baseH);
+            p.minTan.store(minTan);
+            for (int32_t i = 0; i <= xLast - (int32_t)x0; ++i)
+                coneMap(x0 + i, y) = {baseH[i], minTan[i]};
+        }
+    }
+}
@@ -0,0 +1,242 @@
+#include "RayBench.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace ParallaxCpu
+{
+namespace
+{
+// the first t in [t0, t1] with a t^2 + b t + c >= 0, given that it is negative at t0
+bool firstRoot(double a, double b, double c, double t0, double t1, double& t)
+{
+    if (std::abs(a) < 1e-12)
+    {
+        if (b == 0)
+            return false;
+        t = -c / b;
+        return t0 <= t && t <= t1;
+    }
+    const double det = b * b - 4 * a * c;
+    if (det < 0)
+        return false;
+    const double q = -0.5 * (b + std::copysign(std::sqrt(det), b));
+    double r0 = q / a, r1 = q != 0 ? c / q : r0;
+    if (r0 > r1)
+        std::swap(r0, r1);
+    for (double r : {r0, r1})
+    {
+        if (t0 <= r && r <= t1)
+        {
+            t = r;
+            return true;
+        }
+    }
+    return false;
+}
+
+ErrorSummary summarize(std::vector<float>& values)
+{
+    ErrorSummary s;
+    if (values.empty())
+        return s;
+    std::sort(values.begin(), values.end());
+    double sum = 0;
+    for (float v : values)
+        sum += v;
+    const auto percentile = [&](double p) { return values[std::min(values.size() - 1, size_t(p * values.size()))]; };
+    s.mean = sum / values.size();
+    s.p50 = percentile(0.50);
+    s.p99 = percentile(0.99);
+    s.max = values.back();
+    return s;
+}
+} // namespace
+
+ExactHit intersectExact(const Image<float>& heights, const ConeStepRay& ray, float texelCenter, float2 rayHeights)
+{
+    ExactHit hit;
+    if (heights.empty())
+        return hit;
+    // texel space with the texel centers on integers: p(t) = p0 + t d, the ray height is r0 + t dr
+    const double size[2] = {double(heights.width), double(heights.height)};
+    const double p0[2] = {ray.u.x * size[0] - texelCenter, ray.u.y * size[1] - texelCenter};
+    const double d[2] = {(ray.u2.x - ray.u.x) * size[0], (ray.u2.y - ray.u.y) * size[1]};
+    const double r0 = rayHeights.x, dr = double(rayHeights.y) - rayHeights.x;
+
+    // clip to the texture, uv in [0, 1]
+    double tMin = 0, tMax = 1;
+    for (int a = 0; a < 2; ++a)
+    {
+        const double lo = -texelCenter, hi = size[a] - texelCenter;
+        if (d[a] == 0)
+        {
+            if (p0[a] < lo || p0[a] > hi)
+                return hit;
+            continue;
+        }
+        const double ta = (lo - p0[a]) / d[a], tb = (hi - p0[a]) / d[a];
+        tMin = std::max(tMin, std::min(ta, tb));
+        tMax = std::min(tMax, std::max(ta, tb));
+    }
+    if (tMin > tMax)
+        return hit;
+
+    const auto h = [&](int32_t x, int32_t y)
+    {
+        return double(heights(std::clamp(x, 0, (int32_t)heights.width - 1), std::clamp(y, 0, (int32_t)heights.height - 1)));
+    };
+    // 2D DDA over the cells between the texel centers
+    int32_t cell[2];
+    for (int a = 0; a < 2; ++a)
+    {
+        const double p = p0[a] + tMin * d[a];
+        cell[a] = (int32_t)std::floor(p);
+        if (d[a] < 0 && p == cell[a])
+            --cell[a];
+    }
+    const double inf = std::numeric_limits<double>::infinity();
+    double t = tMin;
+    for (;;)
+    {
+        double tNext[2];
+        for (int a = 0; a < 2; ++a)
+            tNext[a] = d[a] > 0 ? (cell[a] + 1 - p0[a]) / d[a] : d[a] < 0 ? (cell[a] - p0[a]) / d[a] : inf;
+        const double tExit = std::min(tMax, std::min(tNext[0], tNext[1]));
+
+        // the bilinear height along the ray minus the ray height, a quadratic in t
+        const double h00 = h(cell[0], cell[1]), h10 = h(cell[0] + 1, cell[1]);
+        const double h01 = h(cell[0], cell[1] + 1), h11 = h(cell[0] + 1, cell[1] + 1);
+        const double e1 = h10 - h00, e2 = h01 - h00, e3 = h00 - h10 - h01 + h11;
+        const double ax = p0[0] - cell[0], bx = d[0], ay = p0[1] - cell[1], by = d[1];
+        const double qa = e3 * bx * by;
+        const double qb = e1 * bx + e2 * by + e3 * (ax * by + bx * ay) - dr;
+        const double qc = h00 + e1 * ax + e2 * ay + e3 * ax * ay - r0;
+        double tHit = t;
+        if (qa * t * t + qb * t + qc >= 0 || firstRoot(qa, qb, qc, t, tExit, tHit))
+        {
+            hit.t = float(tHit);
+            hit.wasHit = true;
+            return hit;
+        }
+        if (tExit >= tMax)
+            return hit;
+        for (int a = 0; a < 2; ++a)
+            cell[a] += tNext[a] == tExit ? (d[a] > 0 ? 1 : -1) : 0;
+        t = tExit;
+    }
+}
+
+GroundTruth computeGroundTruth(const HeightImage& heightmap, const RaySet& set, float texelCenter)
+{
+    Image<float> heights(heightmap.width, heightmap.height);
+    std::transform(heightmap.texels.begin(), heightmap.texels.end(), heights.texels.begin(), unorm16ToFloat);
+    GroundTruth truth;
+    truth.HMres = {float(heightmap.width), float(heightmap.height)};
+    const std::vector<ConeStepRay> rays = set.getAllRays();
+    truth.hits.resize(rays.size());
+    const uint32_t kChunk = 4096;
+    parallelFor(0, uint32_t((rays.size() + kChunk - 1) / kChunk), [&](uint32_t chunk)
+    {
+        for (size_t i = size_t(chunk) * kChunk; i < std::min(rays.size(), size_t(chunk + 1) * kChunk); ++i)
+            truth.hits[i] = intersectExact(heights, rays[i], texelCenter);
+    });
+    return truth;
+}
+
+std::vector<CameraSettings> getBenchmarkCameras()
+{
+    std::vector<CameraSettings> cameras(1); // Parallax::resetCamera
+    // elevation and azimuth in degrees, the directions spread so that the rays run along both texture axes
+    const float views[][2] = {{80, 30}, {45, 120}, {20, 210}, {8, 300}};
+    const float kDistance = 2.2f;
+    for (const auto& view : views)
+    {
+        const float elevation = view[0] * 3.14159265f / 180, azimuth = view[1] * 3.14159265f / 180;
+        CameraSettings camera;
+        camera.position = float3{std::cos(elevation) * std::cos(azimuth), std::sin(elevation), std::cos(elevation) * std::sin(azimuth)} * kDistance;
+        camera.target = {0, 0, 0};
+        cameras.push_back(camera);
+    }
+    return cameras;
+}
+
+RayBenchResult runRayBench(Renderer& renderer, const RenderSettings& settings, const RaySet& set, const GroundTruth& groundTruth, uint32_t repeats)
+{
+    RayBenchResult result;
+    result.parallaxFun = settings.selectedParallaxFun;
+    result.refinementFun = settings.selectedRefinementFun;
+    result.adaptiveSteps = settings.ADAPTIVE_STEPS;
+    const std::vector<ConeStepRay> rays = set.getAllRays();
+    result.rayCount = rays.size();
+    if (rays.empty())
+        return result;
+
+    std::vector<float> footprints;
+    if (settings.ADAPTIVE_STEPS)
+        footprints = set.getAllFootprints(groundTruth.HMres);
+    const float* pFootprints = footprints.empty() ? nullptr : footprints.data();
+
+    // the first run also builds the cone map and the pyramids
+    std::vector<RayHit> hits(rays.size());
+    StatsImage stats((uint32_t)rays.size(), 1);
+    renderer.traceRays(settings, rays.data(), hits.data(), rays.size(), stats.texels.data(), pFootprints);
+    result.stats = summarizeTraceStats(stats);
+
+    result.seconds = std::numeric_limits<double>::infinity();
+    for (uint32_t r = 0; r < std::max(repeats, 1u); ++r)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        renderer.traceRays(settings, rays.data(), hits.data(), rays.size(), nullptr, pFootprints);
+        result.seconds = std::min(result.seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    std::vector<float> uvErrors, depthErrors;
+    size_t i = 0;
+    for (const RayView& view : set.views)
+    {
+        for (size_t v = 0; v < view.rays.size(); ++v, ++i)
+        {
+            const ExactHit& exact = groundTruth.hits[i];
+            if (!std::isfinite(hits[i].uv.x) || !std::isfinite(hits[i].uv.y))
+            {
+                ++result.invalidCount;
+                continue;
+            }
+            const bool onTexture = hits[i].state != TraceState::Missed;
+            result.falseMissCount += exact.wasHit && !onTexture ? 1 : 0;
+            result.falseHitCount += !exact.wasHit && onTexture ? 1 : 0;
+            if (!exact.wasHit || !onTexture)
+                continue;
+            const float2 uv = lerp(rays[i].u, rays[i].u2, exact.t);
+            const float2 e = (hits[i].uv - uv) * groundTruth.HMres;
+            uvErrors.push_back(std::sqrt(e.x * e.x + e.y * e.y));
+            depthErrors.push_back(std::abs(hits[i].t - exact.t) * view.heightMapHeight);
+        }
+    }
+    result.uvError = summarize(uvErrors);
+    result.depthError = summarize(depthErrors);
+    return result;
+}
+
+std::string toString(const RayBenchResult& result)
+{
+    const TraceStatsSummary& s = result.stats;
+    const auto percent = [&](size_t count) { return result.rayCount ? 100.0 * count / result.rayCount : 0.0; };
+    char text[1024];
+    std::snprintf(text, sizeof(text),
+                  "PARALLAX_FUN %u, REFINE_FUN %u%s: %zu rays in %.1f ms, %.2f Mrays/s\n"
+                  "  per ray: %.2f steps (p99 %u), %.2f refine steps, %.2f fetches (p99 %u)\n"
+                  "  %.2f%% hit, %.2f%% not converged, %.2f%% missed; %.3f%% false misses, %.3f%% false hits, %.3f%% NaN\n"
+                  "  uv error [texels]  mean %.4f  p50 %.4f  p99 %.4f  max %.4f\n"
+                  "  depth error        mean %.2e  p50 %.2e  p99 %.2e  max %.2e\n",
+                  result.parallaxFun, result.refinementFun, result.adaptiveSteps ? ", adaptive steps" : "", result.rayCount, result.seconds * 1000, result.rayCount / result.seconds * 1e-6, s.steps.mean,
+                  s.steps.p99, s.refineSteps.mean, s.fetches.mean, s.fetches.p99, percent(s.hitCount), percent(s.notConvergedCount),
+                  percent(s.missedCount), percent(result.falseMissCount), percent(result.falseHitCount), percent(result.invalidCount), result.uvError.mean, result.uvError.p50,
+                  result.uvError.p99, result.uvError.max, result.depthError.mean, result.depthError.p50, result.depthError.p99, result.depthError.max);
+    return text;
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,57 @@
+#pragma once
+#include "RaySet.h"
+#include "Renderer.h"
+#include <string>
+#include <vector>
+
+namespace ParallaxCpu
+{
+// The first intersection of a ray with the bilinear height field, solved per texel cell in double precision
+struct ExactHit
+{
+    float t = 0;         // the hit is at lerp(u, u2, t)
+    bool wasHit = false; // false: the ray leaves the texture before it hits
+};
+
+// texelCenter: 0.5 for the surface of getH (texel centers at (i + 0.5) / size), 0 for the corner patches of MaxMip.
+// rayHeights: the heights of the ray at u and u2 (1: the top plate, 0: the bottom plate), for rays that don't go down.
+ExactHit intersectExact(const Image<float>& heights, const ConeStepRay& ray, float texelCenter = 0.5f, float2 rayHeights = {1, 0});
+
+struct GroundTruth
+{
+    float2 HMres;
+    std::vector<ExactHit> hits; // per ray of RaySet::getAllRays
+};
+GroundTruth computeGroundTruth(const HeightImage& heightmap, const RaySet& set, float texelCenter = 0.5f);
+
+// The scripted views of the benchmark: the default camera and orbits around the square from steep to grazing
+std::vector<CameraSettings> getBenchmarkCameras();
+
+struct ErrorSummary
+{
+    double mean = 0;
+    float p50 = 0, p99 = 0, max = 0;
+};
+
+struct RayBenchResult
+{
+    uint32_t parallaxFun = 0;
+    uint32_t refinementFun = 0;
+    bool adaptiveSteps = false; // ADAPTIVE_STEPS
+    size_t rayCount = 0;
+    double seconds = 0; // the fastest of the repeats
+    TraceStatsSummary stats;
+    // on the rays that hit in the ground truth and stay on the texture in the tracer
+    ErrorSummary uvError;    // texels
+    ErrorSummary depthError; // world units, |t - t exact| * heightMapHeight
+    size_t falseMissCount = 0; // the tracer leaves the texture where the ground truth hits
+    size_t falseHitCount = 0;  // the tracer stays on the texture where the ground truth leaves it
+    size_t invalidCount = 0;   // NaN hits, not in the other counts
+};
+
+// Traces all rays of the set with the PARALLAX_FUN and REFINE_FUN of the settings: once with the
+// trace statistics, then `repeats` timed runs without them
+RayBenchResult runRayBench(Renderer& renderer, const RenderSettings& settings, const RaySet& set, const GroundTruth& groundTruth, uint32_t repeats);
+
+std::string toString(const RayBenchResult& result);
+} // namespace ParallaxCpu
@@ -0,0 +1,379 @@
+// Ray set record and replay benchmark: the perf and accuracy regression suite of the tracers.
+//   ParallaxCpuRayBench record heightmap.pgm rays.bin [-s 960x540] [-m heightMapHeight]
+//   ParallaxCpuRayBench replay heightmap.pgm rays.bin [-f 0,1,2,3,10,11,12,13] [-r 0,1,2,3,4] [-e refineEpsilon] [-n steps] [-a 0,stepsPerTexel,...] [-y minStep,coneSteps]
+//                       [-c coneMap] [-p 0|1] [-i repeats] [-k KiB,ways,lineBytes] [-l tiled|linear] [-g warp|quad|pixel] [-x layout,layout,...] [-d interleaved|planar]
+//   ParallaxCpuRayBench conecheck [heightmap.pgm ...]
+//   ParallaxCpuRayBench querycheck [heightmap.pgm ...]
+// record casts the rays of the scripted views (getBenchmarkCameras) with the default GUI settings.
+// replay traces them with every PARALLAX_FUN x REFINE_FUN combination and compares the refined hits
+// with the exact intersection of the bilinear height field. -a, -y, -c and -p are the ones of ParallaxCpuRender;
+// -e sets the interval (texels) at which REFINE_FUN 3 stops, RenderSettings::refineEpsilon.
+// -a takes a list to compare the fixed budgets (0) with adaptive ones, the footprints are those of the recorded pixels.
+// -k, -l or -g also stream the texels of every fetch through a texture cache model (TextureCache.h).
+// conecheck bakes every quick conemap algorithm on noise maps of power of two and NPOT sizes (and on the given
+// heightmaps) and counts the texels whose cone contains a higher texel center; it fails if there is any.
+// querycheck traces random falling, level and rising rays with each HeightfieldQuery tracer from several threads and on
+// one, on the same maps; it fails if the threads return other hits or an exact hit is off the exact intersection.
+// -x repeats the replay with the CPU textures in each texel layout (row, tiled4, tiled8, morton; TexelLayout.h),
+//    -d stores the cone map in two planes; with -c 0 the falling edge bake is timed in each layout too.
+#include "HeightfieldQuery.h"
+#include "HybridConemap.h"
+#include "ImageIO.h"
+#include "Parallel.h"
+#include "QuickConemap.h"
+#include "RayBench.h"
+#include "TextureCache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace ParallaxCpu;
+
+namespace
+{
+std::vector<uint32_t> parseList(const std::string& value)
+{
+    std::vector<uint32_t> list;
+    std::stringstream ss(value);
+    for (std::string item; std::getline(ss, item, ',');)
+        list.push_back((uint32_t)std::stoul(item));
+    return list;
+}
+
+// Checks the quick cone maps of one heightmap against the texel center bound, returns the number of bad texels
+uint32_t checkQuickConemaps(const std::string& name, const HeightImage& heightmap)
+{
+    uint32_t total = 0;
+    for (uint32_t algorithm = 1; algorithm <= 4; ++algorithm)
+    {
+        float worstRatio = 1.0f;
+        const ConeImage coneMap = generateQuickConemap(QuickConemapSettings{QuickConemapAlgorithm(algorithm)}, heightmap);
+        const uint32_t count = countNonConservativeTexels(heightmap, coneMap, &worstRatio);
+        std::printf("%s %ux%u, quick conemap %u: %u non-conservative texels", name.c_str(), heightmap.width, heightmap.height, algorithm, count);
+        if (count > 0)
+            std::printf(" (exact / stored tan down to %.3f)", worstRatio);
+        std::printf("\n");
+        total += count;
+    }
+    return total;
+}
+
+bool isSameHit(const HeightfieldHit& a, const HeightfieldHit& b)
+{
+    const auto same = [](float3 p, float3 q) { return p.x == q.x && p.y == q.y && p.z == q.z; };
+    return a.hit == b.hit && a.converged == b.converged && a.t == b.t && same(a.position, b.position) && same(a.normal, b.normal) &&
+           same(a.worldPosition, b.worldPosition) && same(a.worldNormal, b.worldNormal) && a.uv.x == b.uv.x && a.uv.y == b.uv.y;
+}
+
+// Checks the HeightfieldQuery tracers on one heightmap, returns the number of failures
+uint32_t checkHeightfieldQueries(const std::string& name, const HeightImage& heightmap)
+{
+    Image<float> heights(heightmap.width, heightmap.height);
+    std::transform(heightmap.texels.begin(), heightmap.texels.end(), heights.texels.begin(), unorm16ToFloat);
+
+    // segments from (u0, r0) to (u1, r1), r the height above the bottom plate relative to the depth, that fall by a tenth
+    // of their start at least (nearly level falling rays span far more than the square on the tracers' volume ray, whose
+    // float t is too coarse for this check), stay level or rise. They keep a texel off the right and bottom edges, where
+    // MaxMip loads 0 and intersectExact clamps.
+    const uint32_t kRayCount = 30000;
+    std::mt19937 rng(heightmap.width * 1000 + heightmap.height);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    const float2 uvMin = {0.5f / heightmap.width, 0.5f / heightmap.height};
+    const float2 uvMax = {std::max(uvMin.x, 1 - 1.5f / heightmap.width), std::max(uvMin.y, 1 - 1.5f / heightmap.height)};
+    const auto randomUv = [&]() { return uvMin + float2{uniform(rng), uniform(rng)} * (uvMax - uvMin); };
+    std::vector<ConeStepRay> segments(kRayCount);
+    std::vector<float2> segmentHeights(kRayCount);
+    for (uint32_t i = 0; i < kRayCount; ++i)
+    {
+        segments[i] = {randomUv(), randomUv()};
+        const float r = uniform(rng);
+        switch (i % 3)
+        {
+        case 0: segmentHeights[i] = {0.3f + r, (0.3f + r) * 0.9f * uniform(rng)}; break;
+        case 1: segmentHeights[i] = {r, r}; break;
+        default: segmentHeights[i] = {0.9f * r, 0.9f * r + (1.3f - 0.9f * r) * uniform(rng)}; break;
+        }
+    }
+
+    uint32_t failures = 0;
+    const std::pair<HeightfieldTracer, const char*> tracers[] = {
+        {HeightfieldTracer::ConeStep, "ConeStep + REFINE_FUN 4"}, {HeightfieldTracer::MaxMip, "MaxMip"}, {HeightfieldTracer::BilinearPatch, "BilinearPatch"}};
+    for (const auto& [tracer, tracerName] : tracers)
+    {
+        if (tracer == HeightfieldTracer::MaxMip && (heightmap.width != heightmap.height || (heightmap.width & (heightmap.width - 1)) != 0))
+        {
+            std::printf("%s %ux%u, %s: skipped, Maximum Mip needs a square power of two heightmap\n", name.c_str(), heightmap.width, heightmap.height, tracerName);
+            continue;
+        }
+        RenderSettings settings;
+        settings.selectedRefinementFun = 4;
+        const HeightfieldQuery query(heightmap, tracer, settings);
+        const float depth = query.getDepth();
+        std::vector<HeightfieldRay> rays(kRayCount);
+        for (uint32_t i = 0; i < kRayCount; ++i)
+        {
+            const float2 u0 = segments[i].u, u1 = segments[i].u2, r = segmentHeights[i];
+            const float3 p0 = {u0.x * 2 - 1, depth * (r.x - 1), u0.y * 2 - 1}, p1 = {u1.x * 2 - 1, depth * (r.y - 1), u1.y * 2 - 1};
+            rays[i] = {p0, p1 - p0, 1.0f};
+        }
+
+        // one query shared by the threads, which take chunks of the rays in turn
+        std::vector<HeightfieldHit> serialHits(kRayCount), hits(kRayCount);
+        query.trace(rays.data(), serialHits.data(), kRayCount);
+        const uint32_t kChunk = 64, threadCount = std::max(4u, getWorkerCount());
+        std::atomic<uint32_t> nextChunk{0};
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; ++t)
+            threads.emplace_back(
+                [&]()
+                {
+                    for (uint32_t first = kChunk * nextChunk++; first < kRayCount; first = kChunk * nextChunk++)
+                        query.trace(rays.data() + first, hits.data() + first, std::min(kChunk, kRayCount - first));
+                });
+        for (std::thread& thread : threads)
+            thread.join();
+        const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        // cone steps can miss thin features or stop past them, so only their level and rising rays must be exact
+        uint32_t threadMismatches = 0, unconverged = 0, falseHits = 0, falseMisses = 0, farHits = 0, inexact = 0;
+        float maxUvError = 0, maxHeightError = 0; // texels, depths
+        for (uint32_t i = 0; i < kRayCount; ++i)
+        {
+            threadMismatches += isSameHit(hits[i], serialHits[i]) ? 0 : 1;
+            const bool mustBeExact = tracer != HeightfieldTracer::ConeStep || segmentHeights[i].y >= segmentHeights[i].x;
+            if (hits[i].hit && !hits[i].converged)
+            {
+                ++unconverged;
+                continue;
+            }
+            const ExactHit exact = intersectExact(heights, segments[i], tracer == HeightfieldTracer::MaxMip ? 0.0f : 0.5f, segmentHeights[i]);
+            if (exact.wasHit != hits[i].hit)
+            {
+                (exact.wasHit ? falseMisses : falseHits)++;
+                inexact += mustBeExact ? 1 : 0;
+                continue;
+            }
+            if (!exact.wasHit)
+                continue;
+            const float dt = std::abs(hits[i].t - exact.t);
+            const float2 du = (segments[i].u2 - segments[i].u) * float2{float(heightmap.width), float(heightmap.height)};
+            const float uvError = dt * std::sqrt(du.x * du.x + du.y * du.y), heightError = dt * std::abs(segmentHeights[i].y - segmentHeights[i].x);
+            maxUvError = std::max(maxUvError, uvError);
+            maxHeightError = std::max(maxHeightError, heightError);
+            const bool far = uvError > 1e-2f || heightError > 1e-4f;
+            farHits += far ? 1 : 0;
+            inexact += far && mustBeExact ? 1 : 0;
+        }
+        std::printf("%s %ux%u, %s: %.2f M rays/s on %u threads, %u rays differ from one thread, %u ran out of steps; %u false hits, "
+                    "%u false misses, %u off the exact hit (up to %.2g texels, %.2g depths), %u of them where it must be exact\n",
+                    name.c_str(), heightmap.width, heightmap.height, tracerName, kRayCount / ms * 1e-3f, threadCount, threadMismatches, unconverged,
+                    falseHits, falseMisses, farHits, maxUvError, maxHeightError, inexact);
+        failures += threadMismatches + inexact;
+    }
+    return failures;
+}
+
+// Runs check on noise maps of power of two and NPOT sizes and on the heightmaps of the command line, returns the exit code
+template<typename F>
+int runCheck(int argc, char** argv, F&& check)
+{
+    uint32_t total = 0;
+    const uint32_t sizes[][2] = {{256, 256}, {128, 64}, {64, 128}, {129, 129}, {100, 37}, {65, 129}, {33, 17}, {97, 1}};
+    for (const auto& size : sizes)
+    {
+        HeightImage heightmap(size[0], size[1]);
+        std::mt19937 rng(size[0] * 1000 + size[1]);
+        for (uint16_t& texel : heightmap.texels)
+            texel = (uint16_t)(rng() & 0xffff);
+        total += check("noise", heightmap);
+    }
+    for (int i = 2; i < argc; ++i)
+    {
+        const HeightImage heightmap = readPgm(argv[i]);
+        if (heightmap.empty())
+        {
+            std::printf("can't read the binary PGM heightmap %s\n", argv[i]);
+            return 1;
+        }
+        total += check(argv[i], heightmap);
+    }
+    return total > 0 ? 1 : 0;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "conecheck")
+        return runCheck(argc, argv, checkQuickConemaps);
+    if (mode == "querycheck")
+        return runCheck(argc, argv, checkHeightfieldQueries);
+    if (argc < 4 || (mode != "record" && mode != "replay"))
+    {
+        std::printf("usage: %s record heightmap.pgm rays.bin [-s WxH] [-m heightMapHeight]\n"
+                    "       %s replay heightmap.pgm rays.bin [-f fun,fun,...] [-r refineFun,...] [-e refineEpsilon] [-n steps] [-a 0,stepsPerTexel,...] [-y minStep,coneSteps]\n"
+                    "              [-c coneMap] [-p 0|1] [-i repeats] [-k KiB,ways,lineBytes] [-l tiled|linear] [-g warp|quad|pixel] [-x layout,...] [-d interleaved|planar]\n"
+                    "       %s conecheck [heightmap.pgm ...]\n"
+                    "       %s querycheck [heightmap.pgm ...]\n",
+                    argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    RenderSettings settings;
+    uint32_t width = 960, height = 540;
+    std::vector<uint32_t> funs = {0, 1, 2, 3, 10, 11, 12, 13};
+    std::vector<uint32_t> refineFuns = {0, 1, 2, 3, 4};
+    std::vector<float> stepsPerTexel = {0}; // 0: the fixed budgets
+    int coneMapAlgorithm = -1;
+    bool packets = true;
+    uint32_t repeats = 3;
+    TextureCacheSettings cacheSettings;
+    bool simulateCache = false;
+    std::vector<TexelLayout> layouts = {TexelLayout::RowMajor};
+    bool planarConeMap = false;
+    for (int i = 4; i + 1 < argc; i += 2)
+    {
+        const std::string opt = argv[i], value = argv[i + 1];
+        if (opt == "-s")
+            std::sscanf(value.c_str(), "%ux%u", &width, &height);
+        else if (opt == "-m")
+            settings.heightMapHeight = std::stof(value);
+        else if (opt == "-f")
+            funs = parseList(value);
+        else if (opt == "-r")
+            refineFuns = parseList(value);
+        else if (opt == "-e")
+            settings.refineEpsilon = std::stof(value);
+        else if (opt == "-n")
+            settings.stepNum = (uint32_t)std::stoul(value);
+        else if (opt == "-a")
+        {
+            stepsPerTexel.clear();
+            std::stringstream ss(value);
+            for (std::string item; std::getline(ss, item, ',');)
+                stepsPerTexel.push_back(std::stof(item));
+        }
+        else if (opt == "-y")
+            std::sscanf(value.c_str(), "%f,%u", &settings.hybridMinStep, &settings.hybridConeSteps);
+        else if (opt == "-c")
+            coneMapAlgorithm = std::stoi(value);
+        else if (opt == "-p")
+            packets = value != "0";
+        else if (opt == "-i")
+            repeats = (uint32_t)std::stoul(value);
+        else if (opt == "-k")
+        {
+            const std::vector<uint32_t> cache = parseList(value);
+            cacheSettings.sizeBytes = cache.size() > 0 ? cache[0] * 1024 : cacheSettings.sizeBytes;
+            cacheSettings.ways = cache.size() > 1 ? cache[1] : cacheSettings.ways;
+            cacheSettings.lineBytes = cache.size() > 2 ? cache[2] : cacheSettings.lineBytes;
+            simulateCache = true;
+        }
+        else if (opt == "-l")
+        {
+            cacheSettings.layout = value == "linear" ? TextureLayout::Linear : TextureLayout::Tiled;
+            simulateCache = true;
+        }
+        else if (opt == "-g")
+        {
+            cacheSettings.grouping = value == "pixel" ? AccessGrouping::Pixel : value == "quad" ? AccessGrouping::Quad : AccessGrouping::Warp;
+            simulateCache = true;
+        }
+        else if (opt == "-x")
+        {
+            layouts.clear();
+            std::stringstream ss(value);
+            TexelLayout layout;
+            for (std::string name; std::getline(ss, name, ',');)
+            {
+                if (parseTexelLayout(name, layout))
+                    layouts.push_back(layout);
+                else
+                    std::printf("unknown texel layout %s\n", name.c_str());
+            }
+        }
+        else if (opt == "-d")
+            planarConeMap = value == "planar";
+    }
+
+    const HeightImage heightmap = readPgm(argv[2]);
+    if (heightmap.empty())
+    {
+        std::printf("can't read the binary PGM heightmap %s\n", argv[2]);
+        return 1;
+    }
+
+    if (mode == "record")
+    {
+        RaySet set;
+        set.heightmapWidth = heightmap.width;
+        set.heightmapHeight = heightmap.height;
+        for (const CameraSettings& camera : getBenchmarkCameras())
+            set.views.push_back(castRays(settings, camera, width, height));
+        const bool saved = writeRaySet(argv[3], set);
+        std::printf("%zu views, %zu rays -> %s%s\n", set.views.size(), set.getRayCount(), argv[3], saved ? "" : " (write failed)");
+        return saved ? 0 : 1;
+    }
+
+    const RaySet set = readRaySet(argv[3]);
+    if (set.views.empty())
+    {
+        std::printf("can't read the ray set %s\n", argv[3]);
+        return 1;
+    }
+    if (set.heightmapWidth != heightmap.width || set.heightmapHeight != heightmap.height)
+        std::printf("note: the rays were recorded on a %ux%u heightmap\n", set.heightmapWidth, set.heightmapHeight);
+    std::printf("%zu views, %zu rays, %u threads\n", set.views.size(), set.getRayCount(), getWorkerCount());
+    if (simulateCache)
+        std::printf("%s\n", toString(cacheSettings).c_str());
+
+    Renderer renderer(heightmap);
+    renderer.setConeStepPackets(packets);
+    if (coneMapAlgorithm > 0)
+        renderer.setConeMap(generateQuickConemap(QuickConemapSettings{QuickConemapAlgorithm(coneMapAlgorithm)}, heightmap));
+
+    // MaxMip intersects the patches between the texel corners, the others the bilinear texture
+    const GroundTruth centers = computeGroundTruth(heightmap, set, 0.5f);
+    GroundTruth corners;
+    for (TexelLayout layout : layouts)
+    {
+        if (layouts.size() > 1 || layout != TexelLayout::RowMajor || planarConeMap)
+            std::printf("texel layout %s, %s cone map\n", toString(layout), planarConeMap ? "planar" : "interleaved");
+        renderer.setTexelLayout(layout, planarConeMap);
+        if (coneMapAlgorithm == 0)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            renderer.setConeMap(generateFallingEdgeConemap(heightmap, layout));
+            const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::printf("falling edge cone map: %.1f ms\n", ms);
+        }
+
+        for (uint32_t fun : funs)
+        {
+            if (fun == 10 && corners.hits.empty())
+                corners = computeGroundTruth(heightmap, set, 0.0f);
+            for (uint32_t refineFun : refineFuns)
+            {
+                for (float perTexel : stepsPerTexel)
+                {
+                    settings.selectedParallaxFun = fun;
+                    settings.selectedRefinementFun = refineFun;
+                    settings.ADAPTIVE_STEPS = perTexel > 0;
+                    settings.adaptiveStepsPerTexel = perTexel > 0 ? perTexel : settings.adaptiveStepsPerTexel;
+                    const RayBenchResult result = runRayBench(renderer, settings, set, fun == 10 ? corners : centers, repeats);
+                    std::printf("%s", toString(result).c_str());
+                    if (simulateCache)
+                        std::printf("%s", toString(simulateTextureCache(renderer, settings, set, cacheSettings, heightmap.width, heightmap.height)).c_str());
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "RaySet.h"
+#include "Math.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace ParallaxCpu
+{
+namespace
+{
+const char kMagic[4] = {'P', 'X', 'R', 'S'};
+const uint32_t kVersion = 1;
+
+struct RayRecord
+{
+    uint32_t pixel;
+    float u[2];
+    float u2[2];
+};
+static_assert(sizeof(RayRecord) == 20, "rays are stored as 5 packed 32 bit values");
+
+template<typename T>
+void writeValue(std::ofstream& file, const T& v)
+{
+    file.write((const char*)&v, sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::ifstream& file, T& v)
+{
+    return (bool)file.read((char*)&v, sizeof(T));
+}
+} // namespace
+
+size_t RaySet::getRayCount() const
+{
+    size_t count = 0;
+    for (const RayView& view : views)
+        count += view.rays.size();
+    return count;
+}
+
+std::vector<ConeStepRay> RaySet::getAllRays() const
+{
+    std::vector<ConeStepRay> rays;
+    rays.reserve(getRayCount());
+    for (const RayView& view : views)
+        rays.insert(rays.end(), view.rays.begin(), view.rays.end());
+    return rays;
+}
+
+std::vector<float> RaySet::getAllFootprints(float2 HMres) const
+{
+    std::vector<float> footprints;
+    footprints.reserve(getRayCount());
+    for (const RayView& view : views)
+    {
+        // the ray of every pixel of the frame, -1: the pixel does not see the square
+        std::vector<int32_t> rayOfPixel(size_t(view.width) * view.height, -1);
+        for (size_t i = 0; i < view.rays.size(); ++i)
+            rayOfPixel[view.pixels[i]] = (int32_t)i;
+        for (size_t i = 0; i < view.rays.size(); ++i)
+        {
+            const uint32_t x = view.pixels[i] % view.width, y = view.pixels[i] / view.width;
+            const auto texels = [&](int32_t dx, int32_t dy)
+            {
+                const int32_t nx = int32_t(x) + dx, ny = int32_t(y) + dy;
+                if (nx < 0 || ny < 0 || nx >= (int32_t)view.width || ny >= (int32_t)view.height)
+                    return -1.0f;
+                const int32_t n = rayOfPixel[size_t(ny) * view.width + nx];
+                if (n < 0)
+                    return -1.0f;
+                const float2 d = (view.rays[n].u - view.rays[i].u) * HMres;
+                return std::sqrt(d.x * d.x + d.y * d.y);
+            };
+            float ddx = texels(1, 0), ddy = texels(0, 1);
+            if (ddx < 0)
+                ddx = texels(-1, 0);
+            if (ddy < 0)
+                ddy = texels(0, -1);
+            footprints.push_back(std::max({ddx, ddy, 0.0f}));
+        }
+    }
+    return footprints;
+}
+
+bool writeRaySet(const std::string& path, const RaySet& set)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    file.write(kMagic, 4);
+    writeValue(file, kVersion);
+    writeValue(file, set.heightmapWidth);
+    writeValue(file, set.heightmapHeight);
+    writeValue(file, (uint32_t)set.views.size());
+    for (const RayView& view : set.views)
+    {
+        writeValue(file, view.width);
+        writeValue(file, view.height);
+        writeValue(file, view.heightMapHeight);
+        writeValue(file, (uint32_t)view.rays.size());
+        std::vector<RayRecord> records(view.rays.size());
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            const ConeStepRay& ray = view.rays[i];
+            records[i] = {view.pixels[i], {ray.u.x, ray.u.y}, {ray.u2.x, ray.u2.y}};
+        }
+        file.write((const char*)records.data(), records.size() * sizeof(RayRecord));
+    }
+    return (bool)file;
+}
+
+RaySet readRaySet(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[4] = {};
+    uint32_t version = 0, viewCount = 0;
+    RaySet set;
+    file.read(magic, 4);
+    if (!file || std::memcmp(magic, kMagic, 4) != 0 || !readValue(file, version) || version != kVersion)
+        return {};
+    if (!readValue(file, set.heightmapWidth) || !readValue(file, set.heightmapHeight) || !readValue(file, viewCount))
+        return {};
+
+    set.views.resize(viewCount);
+    for (RayView& view : set.views)
+    {
+        uint32_t rayCount = 0;
+        if (!readValue(file, view.width) || !readValue(file, view.height) || !readValue(file, view.heightMapHeight) || !readValue(file, rayCount))
+            return {};
+        if (rayCount > uint64_t(view.width) * view.height)
+            return {};
+        std::vector<RayRecord> records(rayCount);
+        if (!file.read((char*)records.data(), records.size() * sizeof(RayRecord)))
+            return {};
+        view.pixels.resize(rayCount);
+        view.rays.resize(rayCount);
+        for (size_t i = 0; i < records.size(); ++i)
+        {
+            view.pixels[i] = records[i].pixel;
+            view.rays[i] = {{records[i].u[0], records[i].u[1]}, {records[i].u2[0], records[i].u2[1]}};
+        }
+    }
+    return set;
+}
+} // namespace ParallaxCpu
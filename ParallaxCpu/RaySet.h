@@ -0,0 +1,38 @@
+#pragma once
+#include "ConeStepPackets.h"
+#include <string>
+#include <vector>
+
+namespace ParallaxCpu
+{
+// The rays of one recorded frame: the (u, u2) pair of every pixel that sees the square.
+// The rays are in tangent space, so they replay the view of any heightmap of the same size.
+struct RayView
+{
+    uint32_t width = 0; // frame size
+    uint32_t height = 0;
+    float heightMapHeight = 0;    // world units per unit of height, for the hit error in world units
+    std::vector<uint32_t> pixels; // y * width + x per ray
+    std::vector<ConeStepRay> rays;
+};
+
+struct RaySet
+{
+    uint32_t heightmapWidth = 0; // the heightmap the views were recorded on, only informative
+    uint32_t heightmapHeight = 0;
+    std::vector<RayView> views;
+
+    size_t getRayCount() const;
+    // the rays of all views in order
+    std::vector<ConeStepRay> getAllRays() const;
+    // the texels the pixel of every ray covers, max(length(ddx(u)), length(ddy(u))) * HMres like main() of
+    // Parallax.ps.slang, from the recorded neighbours of the pixel (the ones before it at the edges of the square)
+    std::vector<float> getAllFootprints(float2 HMres) const;
+};
+
+// Little endian binary file: "PXRS", version, heightmap size, view count, then per view
+// the frame size, heightMapHeight, the ray count and 20 bytes per ray (pixel, u, u2)
+bool writeRaySet(const std::string& path, const RaySet& set);
+// empty views on error
+RaySet readRaySet(const std::string& path);
+} // namespace ParallaxCpu
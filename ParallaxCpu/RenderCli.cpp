@@ -0,0 +1,279 @@
+// Headless reference renderer: renders the textured square with the CPU port of Parallax.ps.slang.
+//   ParallaxCpuRender heightmap.pgm [-o prefix] [-s 1920x1080] [-f 0,1,2,3,10,11,12,13] [-r refineFun] [-e refineEpsilon] [-n steps] [-p 0|1]
+//                     [-a stepsPerTexel] [-y minStep,coneSteps] [-c coneMap] [-t auto|scale] [-x row|tiled4|tiled8|morton] [-d interleaved|planar]
+//                     [-w frames,degrees] [-h 0,1,2,3] [-l x,y,z] [-g heightFun,size[,spheres,radius]] [-m 4|16]
+// Writes <prefix>_fun<PARALLAX_FUN>.png per tracer, the other settings are the GUI defaults.
+// -h renders every tracer once per shadow ray (SHADOW_FUN) to <prefix>_fun<N>_shadow<S>.png; the steps and fetches include the shadow ray.
+// -l sets the light direction (world space, towards the square), a low light casts longer shadows.
+// -g renders a procedural height function (HEIGHT_FUN) instead of heightmap.pgm, which is not read: the other tracers
+//    get it rasterized to a size x size map like ProceduralHeightmap.cs.slang, PARALLAX_FUN 14 traces it directly.
+// -e sets the interval (texels) at which the secant refinement (REFINE_FUN 3) stops.
+// -p 0 traces cone step mapping one ray at a time instead of in SIMD packets.
+// -a gives every ray its own step budget (ADAPTIVE_STEPS) of this many primary steps per crossed texel, 0: the fixed budgets.
+// -y sets when PARALLAX_FUN 13 switches from cone steps to Maximum Mip (RenderSettings::hybridMinStep, hybridConeSteps).
+// -c selects the cone map of PARALLAX_FUN 3 and 13: 1-4 the quick conemap algorithms (QUICK_GEN_ALG), 0 the exact falling edge cones.
+// -t prints the per pixel trace statistics and writes <prefix>_fun<N>_steps.png and _fetches.png heatmaps,
+//    scaled to the p99 of the frame (auto) or to a fixed count to compare runs.
+// -w renders a camera path of `frames` frames that orbits the default camera by `degrees` per frame, once traced
+//    from the top plate and once with the temporal warm start (Renderer::setWarmStart), and prints the steps of both
+//    and the difference of the frames. Writes <prefix>_fun<N>_path<frame>.png of the warm started frames.
+// -m supersamples every pixel with this many sub-samples (a square number), once with every sub-sample traced from the
+//    top plate and once sharing the steps of the pixel's central ray (Renderer::setSupersampling), and prints the time and
+//    the steps of both and the difference of the frames.
+//    Writes <prefix>_fun<N>_ssaa<samples>.png of the shared frame and _ssaa<samples>_separate.png of the other one.
+// -x and -d pick the texel layout of the CPU textures and the cone map planes (Renderer::setTexelLayout), the frames are the same.
+#include "HybridConemap.h"
+#include "ImageIO.h"
+#include "Parallel.h"
+#include "ProceduralHeight.h"
+#include "QuickConemap.h"
+#include "Renderer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+using namespace ParallaxCpu;
+
+namespace
+{
+// The camera turned around the vertical axis through its target
+CameraSettings orbit(CameraSettings camera, float degrees)
+{
+    const float a = degrees * 3.14159265f / 180, c = std::cos(a), s = std::sin(a);
+    const float3 d = camera.position - camera.target;
+    camera.position = camera.target + float3{c * d.x + s * d.z, d.y, -s * d.x + c * d.z};
+    return camera;
+}
+
+// -w: the camera path traced from the top plate and with the warm start
+void renderPath(const Renderer& renderer, RenderSettings settings, const CameraSettings& camera, uint32_t width, uint32_t height, uint32_t frames,
+                float degrees, const std::string& prefix)
+{
+    Renderer cold = renderer, warm = renderer;
+    cold.setWarmStart(false);
+    warm.setWarmStart(true);
+    double coldSteps = 0, warmSteps = 0;
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+        const CameraSettings frameCamera = orbit(camera, f * degrees);
+        StatsImage coldStats, warmStats;
+        const Image<float3> coldFrame = cold.render(settings, frameCamera, width, height, &coldStats);
+        const Image<float3> warmFrame = warm.render(settings, frameCamera, width, height, &warmStats);
+        const TraceStatsSummary c = summarizeTraceStats(coldStats), w = summarizeTraceStats(warmStats);
+        uint32_t differ = 0;
+        float maxDiff = 0;
+        for (size_t i = 0; i < coldFrame.texels.size(); ++i)
+        {
+            const float3 d = coldFrame.texels[i] - warmFrame.texels[i];
+            const float m = std::max({std::abs(d.x), std::abs(d.y), std::abs(d.z)});
+            differ += m > 1.0f / 255 ? 1 : 0;
+            maxDiff = std::max(maxDiff, m);
+        }
+        std::printf("  frame %2u: steps %.2f -> %.2f (p99 %u -> %u), fetches %.2f -> %.2f, %u pixels differ by more than 1/255, max %.3f\n", f, c.steps.mean,
+                    w.steps.mean, c.steps.p99, w.steps.p99, c.fetches.mean, w.fetches.mean, differ, maxDiff);
+        coldSteps += c.steps.mean;
+        warmSteps += w.steps.mean;
+        writePng(prefix + "_path" + std::to_string(f) + ".png", warmFrame);
+    }
+    std::printf("  mean steps %.2f -> %.2f over %u frames (%.1f%% saved)\n", coldSteps / frames, warmSteps / frames, frames,
+                coldSteps > 0 ? 100 * (1 - warmSteps / coldSteps) : 0.0);
+}
+
+// -m: the supersampled frame with and without sharing the steps of the central ray
+void renderSupersampled(const Renderer& renderer, const RenderSettings& settings, const CameraSettings& camera, uint32_t width, uint32_t height,
+                        uint32_t samples, const std::string& prefix)
+{
+    const uint32_t perAxis = (uint32_t)std::lround(std::sqrt(float(samples)));
+    Renderer separate = renderer, shared = renderer;
+    separate.setSupersampling(perAxis, false);
+    shared.setSupersampling(perAxis, true);
+    StatsImage separateStats, sharedStats;
+    auto start = std::chrono::steady_clock::now();
+    const Image<float3> separateFrame = separate.render(settings, camera, width, height, &separateStats);
+    const float separateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    start = std::chrono::steady_clock::now();
+    const Image<float3> sharedFrame = shared.render(settings, camera, width, height, &sharedStats);
+    const float sharedMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const TraceStatsSummary a = summarizeTraceStats(separateStats), b = summarizeTraceStats(sharedStats);
+    uint32_t differ = 0;
+    float maxDiff = 0;
+    for (size_t i = 0; i < separateFrame.texels.size(); ++i)
+    {
+        const float3 d = separateFrame.texels[i] - sharedFrame.texels[i];
+        const float m = std::max({std::abs(d.x), std::abs(d.y), std::abs(d.z)});
+        differ += m > 1.0f / 255 ? 1 : 0;
+        maxDiff = std::max(maxDiff, m);
+    }
+    std::printf("  %ux%u sub-samples: %.1f ms -> %.1f ms (%.2fx), steps per pixel %.2f -> %.2f, fetches %.2f -> %.2f\n", perAxis, perAxis, separateMs, sharedMs,
+                sharedMs > 0 ? separateMs / sharedMs : 0.0f, a.steps.mean, b.steps.mean, a.fetches.mean, b.fetches.mean);
+    std::printf("  %u pixels differ by more than 1/255, max %.3f\n", differ, maxDiff);
+    writePng(prefix + "_ssaa" + std::to_string(perAxis * perAxis) + ".png", sharedFrame);
+    writePng(prefix + "_ssaa" + std::to_string(perAxis * perAxis) + "_separate.png", separateFrame);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::printf("usage: %s heightmap.pgm [-o prefix] [-s WxH] [-f fun,fun,...] [-r refineFun] [-e refineEpsilon] [-n steps] [-p 0|1] [-c coneMap]\n"
+                    "       [-t auto|scale] [-a stepsPerTexel] [-y minStep,coneSteps] [-x row|tiled4|tiled8|morton] [-d interleaved|planar] [-w frames,degrees]\n"
+                    "       [-h shadowFun,...] [-l x,y,z] [-g heightFun,size[,spheres,radius]] [-m samples]\n",
+                    argv[0]);
+        return 1;
+    }
+
+    RenderSettings settings;
+    CameraSettings camera;
+    std::string prefix = "frame";
+    uint32_t width = 1920, height = 1080;
+    std::vector<uint32_t> funs = {0, 1, 2, 3, 10, 11, 12, 13};
+    std::vector<uint32_t> shadowFuns; // empty: the default, without a suffix
+    bool packets = true;
+    int coneMapAlgorithm = -1;
+    bool traceStats = false;
+    float heatmapScale = 0; // 0: the p99 of each frame
+    TexelLayout layout = TexelLayout::RowMajor;
+    bool planarConeMap = false;
+    uint32_t pathFrames = 0;
+    bool procedural = false;
+    ProceduralHeightSettings proceduralSettings;
+    float pathDegrees = 0;
+    uint32_t supersamples = 0;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        const std::string opt = argv[i], value = argv[i + 1];
+        if (opt == "-o")
+            prefix = value;
+        else if (opt == "-s")
+            std::sscanf(value.c_str(), "%ux%u", &width, &height);
+        else if (opt == "-r")
+            settings.selectedRefinementFun = (uint32_t)std::stoul(value);
+        else if (opt == "-e")
+            settings.refineEpsilon = std::stof(value);
+        else if (opt == "-n")
+            settings.stepNum = (uint32_t)std::stoul(value);
+        else if (opt == "-a")
+        {
+            settings.adaptiveStepsPerTexel = std::stof(value);
+            settings.ADAPTIVE_STEPS = settings.adaptiveStepsPerTexel > 0;
+        }
+        else if (opt == "-y")
+            std::sscanf(value.c_str(), "%f,%u", &settings.hybridMinStep, &settings.hybridConeSteps);
+        else if (opt == "-p")
+            packets = value != "0";
+        else if (opt == "-c")
+            coneMapAlgorithm = std::stoi(value);
+        else if (opt == "-t")
+        {
+            traceStats = true;
+            heatmapScale = value == "auto" ? 0.0f : std::stof(value);
+        }
+        else if (opt == "-x")
+        {
+            if (!parseTexelLayout(value, layout))
+                std::printf("unknown texel layout %s\n", value.c_str());
+        }
+        else if (opt == "-d")
+            planarConeMap = value == "planar";
+        else if (opt == "-l")
+        {
+            std::sscanf(value.c_str(), "%f,%f,%f", &settings.lightDir.x, &settings.lightDir.y, &settings.lightDir.z);
+            settings.lightDir = normalize(settings.lightDir);
+        }
+        else if (opt == "-g")
+        {
+            procedural = true;
+            std::sscanf(value.c_str(), "%u,%u,%d,%f", &proceduralSettings.heightFun, &proceduralSettings.width, &proceduralSettings.intParams[0],
+                        &proceduralSettings.floatParams[0]);
+            proceduralSettings.height = proceduralSettings.width;
+        }
+        else if (opt == "-m")
+            supersamples = (uint32_t)std::stoul(value);
+        else if (opt == "-w")
+            std::sscanf(value.c_str(), "%u,%f", &pathFrames, &pathDegrees);
+        else if (opt == "-f" || opt == "-h")
+        {
+            std::vector<uint32_t>& list = opt == "-f" ? funs : shadowFuns;
+            list.clear();
+            std::stringstream ss(value);
+            for (std::string f; std::getline(ss, f, ',');)
+                list.push_back((uint32_t)std::stoul(f));
+        }
+    }
+
+    const HeightImage heightmap = procedural ? generateProceduralHeightmap(proceduralSettings) : readPgm(argv[1]);
+    if (heightmap.empty())
+    {
+        std::printf("can't read the binary PGM heightmap %s\n", argv[1]);
+        return 1;
+    }
+
+    Renderer renderer(heightmap);
+    renderer.setConeStepPackets(packets);
+    renderer.setTexelLayout(layout, planarConeMap);
+    renderer.setProceduralHeight(proceduralSettings);
+    if (coneMapAlgorithm == 0)
+        renderer.setConeMap(generateFallingEdgeConemap(heightmap, layout));
+    else if (coneMapAlgorithm > 0)
+        renderer.setConeMap(generateQuickConemap(QuickConemapSettings{QuickConemapAlgorithm(coneMapAlgorithm)}, heightmap));
+
+    if (pathFrames > 0)
+    {
+        for (uint32_t fun : funs)
+        {
+            settings.selectedParallaxFun = fun;
+            std::printf("PARALLAX_FUN %u, %u frames orbiting %.2f degrees per frame:\n", fun, pathFrames, pathDegrees);
+            renderPath(renderer, settings, camera, width, height, pathFrames, pathDegrees, prefix + "_fun" + std::to_string(fun));
+        }
+        return 0;
+    }
+
+    if (supersamples > 1)
+    {
+        for (uint32_t fun : funs)
+        {
+            settings.selectedParallaxFun = fun;
+            std::printf("PARALLAX_FUN %u, %u samples per pixel:\n", fun, supersamples);
+            renderSupersampled(renderer, settings, camera, width, height, supersamples, prefix + "_fun" + std::to_string(fun));
+        }
+        return 0;
+    }
+
+    const bool shadowSuffix = !shadowFuns.empty();
+    if (shadowFuns.empty())
+        shadowFuns.push_back(settings.selectedShadowFun);
+    for (uint32_t fun : funs)
+    {
+        for (uint32_t shadowFun : shadowFuns)
+        {
+            settings.selectedParallaxFun = fun;
+            settings.selectedShadowFun = shadowFun;
+            StatsImage stats;
+            const auto start = std::chrono::steady_clock::now();
+            const Image<float3> frame = renderer.render(settings, camera, width, height, traceStats ? &stats : nullptr);
+            const float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            const std::string name = prefix + "_fun" + std::to_string(fun) + (shadowSuffix ? "_shadow" + std::to_string(shadowFun) : "");
+            const bool saved = writePng(name + ".png", frame);
+            std::printf("PARALLAX_FUN %u%s: %ux%u in %.1f ms on %u threads -> %s.png%s\n", fun,
+                        shadowSuffix ? (", SHADOW_FUN " + std::to_string(shadowFun)).c_str() : "", width, height, ms, getWorkerCount(), name.c_str(),
+                        saved ? "" : " (write failed)");
+
+            if (traceStats)
+            {
+                const TraceStatsSummary summary = summarizeTraceStats(stats);
+                std::printf("%s", toString(summary).c_str());
+                for (TraceCounter counter : {TraceCounter::Steps, TraceCounter::Fetches})
+                {
+                    const float scale = heatmapScale > 0 ? heatmapScale : float(summary[counter].p99);
+                    writePng(name + (counter == TraceCounter::Steps ? "_steps.png" : "_fetches.png"), makeHeatmap(stats, counter, scale));
+                }
+            }
+        }
+    }
+    return 0;
+}
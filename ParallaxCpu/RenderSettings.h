@@ -0,0 +1,75 @@
+#pragma once
+#include "Math.h"
+#include <cstdint>
+
+namespace ParallaxCpu
+{
+// The render settings of the GUI. The app instantiates it with Falcor's float3, the CPU renderer
+// with ParallaxCpu::float3; the converting constructor copies between the two.
+template<typename Float3>
+struct RenderSettingsT
+{
+    Float3 lightDir{0.197914f, -0.461799f, -0.864623f}; // normalize(.198, -.462, -.865)
+    float heightMapHeight = 0.2f;
+    bool discardFragments = true;
+    bool displayNonConverged = true;
+    float lightIntensity = 1.0f;
+    uint32_t stepNum = 200;
+    uint32_t refineStepNum = 5;
+    float refineEpsilon = 0.1f; // REFINE_FUN 3 stops once the interval is shorter than this (texels)
+    Float3 scale{1, 1, 1};
+    float angle = 0.0f;
+    Float3 axis{0, 0, 1};
+    Float3 translate{0, 0, 0};
+    float relax = 1.0f;
+    bool BILINEAR_BY_HAND = false;
+    bool CONSERVATIVE_STEP = false;
+    float hybridMinStep = 2.0f;         // PARALLAX_FUN 13 switches to Maximum Mip after a cone step shorter than this (texels)
+    uint32_t hybridConeSteps = 16;      // or after this many cone steps
+    bool ADAPTIVE_STEPS = false;        // per ray step budgets, see setRayStepBudget in Parallax.ps.slang
+    float adaptiveStepsPerTexel = 2.0f; // primary steps per texel that the ray crosses
+    float shadowSoftness = 0.05f;       // SHADOW_FUN 3: the tan of the light's angular radius
+    uint32_t selectedParallaxFun = 3;   // PARALLAX_FUN
+    uint32_t selectedRefinementFun = 0; // REFINE_FUN
+    uint32_t selectedShadowFun = 0;     // SHADOW_FUN
+
+    RenderSettingsT() = default;
+    template<typename Other>
+    explicit RenderSettingsT(const RenderSettingsT<Other>& o)
+        : lightDir{o.lightDir.x, o.lightDir.y, o.lightDir.z}
+        , heightMapHeight(o.heightMapHeight)
+        , discardFragments(o.discardFragments)
+        , displayNonConverged(o.displayNonConverged)
+        , lightIntensity(o.lightIntensity)
+        , stepNum(o.stepNum)
+        , refineStepNum(o.refineStepNum)
+        , refineEpsilon(o.refineEpsilon)
+        , scale{o.scale.x, o.scale.y, o.scale.z}
+        , angle(o.angle)
+        , axis{o.axis.x, o.axis.y, o.axis.z}
+        , translate{o.translate.x, o.translate.y, o.translate.z}
+        , relax(o.relax)
+        , BILINEAR_BY_HAND(o.BILINEAR_BY_HAND)
+        , CONSERVATIVE_STEP(o.CONSERVATIVE_STEP)
+        , hybridMinStep(o.hybridMinStep)
+        , hybridConeSteps(o.hybridConeSteps)
+        , ADAPTIVE_STEPS(o.ADAPTIVE_STEPS)
+        , adaptiveStepsPerTexel(o.adaptiveStepsPerTexel)
+        , shadowSoftness(o.shadowSoftness)
+        , selectedParallaxFun(o.selectedParallaxFun)
+        , selectedRefinementFun(o.selectedRefinementFun)
+        , selectedShadowFun(o.selectedShadowFun)
+    {}
+};
+
+using RenderSettings = RenderSettingsT<float3>;
+
+// Falcor's look-at camera; the defaults are the ones of Parallax::resetCamera
+struct CameraSettings
+{
+    float3 position{-0.9f, 0.1f, -0.9f};
+    float3 target{0.0f, -0.6f, 0.0f};
+    float3 up{0.0f, 1.0f, 0.0f};
+    float fovY = 1.03829f; // 21 mm focal length on a 24 mm frame
+};
+} // namespace ParallaxCpu
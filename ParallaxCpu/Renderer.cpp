@@ -0,0 +1,1640 @@
+#include "Renderer.h"
+#include "ConeStepPackets.h"
+#include "Parallel.h"
+#include "QuickConemap.h"
+#include "TraceStats.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ParallaxCpu
+{
+namespace
+{
+// The warm start brackets the predicted hit by this many minimum cone steps (texels along the ray) on either side
+const float kWarmStartBackoff = 0.5f;
+// the cone samples that warmStartConeStep may take before the ray is traced from the top plate
+const uint32_t kWarmStartCertifySteps = 16;
+// kShadowMinStep of Shadow.slang
+const float kShadowMinStep = 0.1f;
+// kProceduralMinStep of FindIntersection.slang
+const float kProceduralMinStep = 0.01f;
+
+// One max reduction step of HeightPyramid.cs.slang (main_mip)
+Image<float> reduceMax(const Image<float>& src)
+{
+    Image<float> dst(std::max(1u, src.width / 2), std::max(1u, src.height / 2));
+    for (uint32_t y = 0; y < dst.height; ++y)
+    {
+        // the last node below an odd size also covers the third row/column
+        const uint32_t extentY = (y + 1 == dst.height && src.height > 2 * dst.height) ? 3 : 2;
+        for (uint32_t x = 0; x < dst.width; ++x)
+        {
+            const uint32_t extentX = (x + 1 == dst.width && src.width > 2 * dst.width) ? 3 : 2;
+            float m = 0;
+            for (uint32_t j = 0; j < extentY; ++j)
+                for (uint32_t i = 0; i < extentX; ++i)
+                    m = std::max(m, src(std::min(2 * x + i, src.width - 1), std::min(2 * y + j, src.height - 1)));
+            dst(x, y) = m;
+        }
+    }
+    return dst;
+}
+
+// reduced row-major, stored in the layout
+FloatMips buildMaxMips(Image<float> level0, TexelLayout layout)
+{
+    FloatMips chain;
+    Image<float> level = std::move(level0);
+    for (;;)
+    {
+        chain.mips.emplace_back(level, layout);
+        if (level.width == 1 && level.height == 1)
+            break;
+        level = reduceMax(level);
+    }
+    return chain;
+}
+
+// max of the texels (x, y) + [x0, x1] x [y0, y1], clamped to the edges
+Image<float> neighbourMax(const Image<float>& heights, int32_t x0, int32_t x1, int32_t y0, int32_t y1)
+{
+    Image<float> dst(heights.width, heights.height);
+    const int32_t maxX = (int32_t)heights.width - 1, maxY = (int32_t)heights.height - 1;
+    parallelFor(0, heights.height, [&](uint32_t y)
+    {
+        for (uint32_t x = 0; x < heights.width; ++x)
+        {
+            float m = 0;
+            for (int32_t j = y0; j <= y1; ++j)
+                for (int32_t i = x0; i <= x1; ++i)
+                    m = std::max(m, heights(std::clamp((int32_t)x + i, 0, maxX), std::clamp((int32_t)y + j, 0, maxY)));
+            dst(x, y) = m;
+        }
+    });
+    return dst;
+}
+
+// Bilinear sample with clamp addressing, texel centers at (i + 0.5) / size; of an Image, a LayoutImage or the ConeTexture
+template<typename ImageT>
+auto sampleBilinear(const ImageT& image, float2 uv)
+{
+    const float fx = uv.x * image.width - 0.5f, fy = uv.y * image.height - 0.5f;
+    const float x0f = std::floor(fx), y0f = std::floor(fy);
+    const float wx = fx - x0f, wy = fy - y0f;
+    const auto clampX = [&](float v) { return (uint32_t)std::clamp(v, 0.0f, float(image.width - 1)); };
+    const auto clampY = [&](float v) { return (uint32_t)std::clamp(v, 0.0f, float(image.height - 1)); };
+    const uint32_t x0 = clampX(x0f), x1 = clampX(x0f + 1), y0 = clampY(y0f), y1 = clampY(y0f + 1);
+    const auto top = image(x0, y0) * (1 - wx) + image(x1, y0) * wx;
+    const auto bottom = image(x0, y1) * (1 - wx) + image(x1, y1) * wx;
+    return top * (1 - wy) + bottom * wy;
+}
+
+float copySign(float x, float y)
+{
+    return y < 0 ? -std::abs(x) : y > 0 ? std::abs(x) : 0.0f;
+}
+
+// IntersectBilinearPatch.slang; the crossings before tMin are behind the ray
+bool intersectBilinearPatch(float& t, float3 q00, float3 q01, float3 q10, float3 q11, float3 rayOrigin, float3 rayTarget, float tMin = -INFINITY)
+{
+    t = INFINITY;
+    const float3 rayDir = rayTarget - rayOrigin;
+    const float3 e11 = q11 - q10;
+    const float3 e00 = q01 - q00;
+    const float3 qn = cross(q10 - q00, q01 - q11);
+    q00 = q00 - rayOrigin;
+    q10 = q10 - rayOrigin;
+    const float a = dot(cross(q00, rayDir), e00);
+    const float c = dot(qn, rayDir);
+    float b = dot(cross(q10, rayDir), e11);
+    b -= a + c;
+    float det = b * b - 4.f * a * c;
+    if (det < 0.f)
+        return false;
+    det = std::sqrt(det);
+
+    float u1, u2;
+    if (c == 0.f)
+    {
+        u1 = -a / b;
+        u2 = -1.f;
+    }
+    else
+    {
+        u1 = (-b - copySign(det, b)) / 2.f;
+        u2 = a / u1;
+        u1 /= c;
+    }
+    for (float uu : {u1, u2})
+    {
+        if (0.f <= uu && uu <= 1.f)
+        {
+            const float3 pa = lerp(q00, q10, uu);
+            const float3 pb = lerp(e00, e11, uu);
+            float3 n = cross(rayDir, pb);
+            const float d = dot(n, n);
+            n = cross(n, pa);
+            const float tt = dot(n, pb) / d;
+            const float v = dot(n, rayDir) / d;
+            if (0.f <= v && v <= 1.0f && tMin <= tt && tt < t)
+                t = tt;
+        }
+    }
+    return 0.f <= t && t <= 1.f;
+}
+
+struct HMapIntersection
+{
+    float2 uv;
+    float t = 0; // uv = (1-t)*u + t*u2
+    float last_t = 0;
+    bool wasHit = false;
+};
+
+float rcpOr1e16(float v)
+{
+    return v == 0.0f ? 1e16f : 1.0f / v;
+}
+
+// The FScb constants and textures of Parallax.ps.slang; the methods are ports of FindIntersection.slang,
+// Refinement.slang and the shading of main()
+struct PixelShader
+{
+    const RenderSettings& settings;
+    const LayoutImage<float>& heights;
+    const ConeTexture& coneMap;
+    const FloatMips& pyramidMax;
+    const FloatMips& pyramidCellMax;
+    const FloatMips& pyramidBorderMax;
+    const Image<float3>& albedo;
+    const ProceduralHeightSettings& proceduralSettings; // the height function of PARALLAX_FUN 14
+    float2 HMres = {};
+    float2 HMres_r = {};
+    uint32_t HMMaxMip = 0;
+    // rows of the inverse of the [T B N] column matrix (invMat)
+    float3 r1 = {}, r2 = {}, r3 = {};
+    // the TRACE_STATS counters of the current pixel; null: not counted
+    PixelStats* stats = nullptr;
+    // the texels read by the current pixel's search and refinement; null: not recorded
+    std::vector<TexelAccess>* texels = nullptr;
+    // the step limits of the current pixel's ray, see setRayStepBudget
+    uint32_t rayStepNum = 0;
+    float rayTexels = 0;
+    float rayFootprint = 0;
+    // where cone step mapping starts on the current pixel's ray, see Renderer::setWarmStart
+    float rayStartSc = 0;
+    // where MaxMip and QDMBilinear start on the current ray (lerp(u, u2, t)), see Renderer::traceRaysPrepared
+    float rayStartT = 0;
+    // the patches of a ray that starts inside the volume may also be crossed behind its start
+    float patchMinT() const { return rayStartT > 0 ? rayStartT : -INFINITY; }
+
+    int32_t steps() const { return (int32_t)rayStepNum; }
+    void countStep() const { if (stats) ++stats->steps; }
+    void countRefineStep() const { if (stats) ++stats->refineSteps; }
+    void countFetches(uint32_t n) const { if (stats) stats->fetches += n; }
+
+    void recordTexel(TextureId texture, uint32_t mip, uint32_t x, uint32_t y, bool newFetch = true) const
+    {
+        if (texels)
+            texels->push_back({texture, uint8_t(mip), newFetch, x, y});
+    }
+    // the 4 texels of sampleBilinear on a mip of the given size
+    void recordBilinear(TextureId texture, uint32_t mip, uint32_t width, uint32_t height, float2 uv) const
+    {
+        if (!texels)
+            return;
+        const float fx = std::floor(uv.x * width - 0.5f), fy = std::floor(uv.y * height - 0.5f);
+        const auto clampX = [&](float v) { return (uint32_t)std::clamp(v, 0.0f, float(width - 1)); };
+        const auto clampY = [&](float v) { return (uint32_t)std::clamp(v, 0.0f, float(height - 1)); };
+        recordTexel(texture, mip, clampX(fx), clampY(fy));
+        recordTexel(texture, mip, clampX(fx + 1), clampY(fy), false);
+        recordTexel(texture, mip, clampX(fx), clampY(fy + 1), false);
+        recordTexel(texture, mip, clampX(fx + 1), clampY(fy + 1), false);
+    }
+    // the pyramid is the gTexture of the QDM tracers, so their getH reads its level 0
+    void recordGetH(float2 uv) const
+    {
+        switch (settings.selectedParallaxFun)
+        {
+        case 3:
+        case 13: recordBilinear(TextureId::ConeMap, 0, coneMap.width, coneMap.height, uv); break;
+        case 10: recordBilinear(TextureId::Pyramid, 0, heights.width, heights.height, uv + 0.5f * HMres_r); break;
+        case 11:
+        case 12: recordBilinear(TextureId::Pyramid, 0, heights.width, heights.height, uv); break;
+        default: recordBilinear(TextureId::Heightmap, 0, heights.width, heights.height, uv); break;
+        }
+    }
+
+    // getH without counting a fetch, for the shading
+    float sampleH(float2 uv) const
+    {
+        switch (settings.selectedParallaxFun)
+        {
+        case 3:
+        case 13: return sampleBilinear(coneMap, uv).x; // gTexture is the cone map
+        case 10: return pyramidMax.sampleLevel(uv + 0.5f * HMres_r, 0);
+        case 14: return proceduralHeight(proceduralSettings, uv);
+        default: return sampleBilinear(heights, uv);
+        }
+    }
+    float getH(float2 uv) const
+    {
+        if (settings.selectedParallaxFun == 14)
+            return sampleH(uv); // evaluated, nothing is fetched
+        countFetches(1);
+        recordGetH(uv);
+        return sampleH(uv);
+    }
+    // BILINEAR_BY_HAND gives the same result as the filtering here, with two gathers
+    float2 getHC(float2 uv) const
+    {
+        countFetches(settings.BILINEAR_BY_HAND ? 2 : 1);
+        recordBilinear(TextureId::ConeMap, 0, coneMap.width, coneMap.height, uv);
+        return sampleBilinear(coneMap, uv);
+    }
+
+    // setRayStepBudget of Parallax.ps.slang: with ADAPTIVE_STEPS the primary budget follows the texels the ray
+    // crosses and the texels its pixel covers, and the refinement stops once the hit is resolved to the pixel
+    void setRayStepBudget(float2 u, float2 u2, float footprint)
+    {
+        const float2 d = (u2 - u) * HMres;
+        rayTexels = std::sqrt(d.x * d.x + d.y * d.y);
+        rayFootprint = footprint;
+        rayStepNum = settings.stepNum;
+        if (settings.ADAPTIVE_STEPS)
+        {
+            // room for the cone steps and the hierarchical tracers to climb and descend the pyramid a few times
+            const float pyramidSteps = 4.0f * std::ceil(std::log2(std::max(HMres.x, HMres.y)));
+            const float budget = std::ceil(rayTexels * settings.adaptiveStepsPerTexel / std::max(footprint, 1.0f)) + pyramidSteps;
+            rayStepNum = uint32_t(std::clamp(budget, 1.0f, float(settings.stepNum)));
+        }
+    }
+    bool isResolved(float t0, float t1) const { return settings.ADAPTIVE_STEPS && (t1 - t0) * rayTexels <= rayFootprint; }
+
+    HMapIntersection bumpMapping(float2, float2 u2) const
+    {
+        HMapIntersection ret;
+        ret.uv = u2;
+        ret.t = 1;
+        ret.last_t = 1;
+        return ret;
+    }
+
+    HMapIntersection parallaxMapping(float2 u, float2 u2) const
+    {
+        const float t = 1 - getH(u2);
+        HMapIntersection ret;
+        ret.uv = (1 - t) * u + t * u2;
+        ret.t = t;
+        ret.last_t = t;
+        return ret;
+    }
+
+    HMapIntersection linearSearch(float2 u, float2 u2) const
+    {
+        HMapIntersection ret;
+        const float dt = 1.0f / rayStepNum;
+        float t = 1;
+        const float2 du = (u2 - u) * dt;
+        float2 uu = u;
+        for (int32_t i = 0; i < steps(); ++i)
+        {
+            t -= dt;
+            uu = uu + du;
+            countStep();
+            if (getH(uu) >= t)
+            {
+                ret.wasHit = true;
+                break;
+            }
+        }
+        ret.uv = uu;
+        ret.t = 1 - t;
+        ret.last_t = 1 - t - dt;
+        return ret;
+    }
+
+    ConeStepSettings coneStepSettings() const { return {rayStepNum, settings.relax, settings.CONSERVATIVE_STEP}; }
+    HMapIntersection toIntersection(const ConeStepHit& hit, float2 u, float2 u2) const
+    {
+        if (stats)
+        {
+            stats->steps += hit.stepCount;
+            stats->fetches += (hit.stepCount + 1) * (settings.BILINEAR_BY_HAND ? 2 : 1);
+        }
+        HMapIntersection ret;
+        ret.uv = (1 - hit.t) * u + hit.t * u2;
+        ret.t = hit.t;
+        ret.last_t = hit.lastT;
+        ret.wasHit = hit.wasHit;
+        return ret;
+    }
+    HMapIntersection coneStepMapping(float2 u, float2 u2) const
+    {
+        if (!texels)
+            return toIntersection(traceConeStep(coneStepSettings(), coneMap, {u, u2}, nullptr, rayStartSc), u, u2);
+        std::vector<float2> samples;
+        const ConeStepHit hit = traceConeStep(coneStepSettings(), coneMap, {u, u2}, &samples, rayStartSc);
+        for (float2 uv : samples)
+            recordBilinear(TextureId::ConeMap, 0, coneMap.width, coneMap.height, uv);
+        return toIntersection(hit, u, u2);
+    }
+
+    float loadQDMNode(const FloatMips& pyramid, uint32_t nodeX, uint32_t nodeY, int32_t level) const
+    {
+        const uint32_t mip = std::min((uint32_t)level, pyramid.getMipCount() - 1);
+        const uint32_t shift = (level - mip) & 31; // like the shader's shift
+        const LayoutImage<float>& m = pyramid.mips[mip];
+        const uint32_t x = std::min(nodeX >> shift, m.width - 1), y = std::min(nodeY >> shift, m.height - 1);
+        countFetches(1);
+        recordTexel(TextureId::Pyramid, mip, x, y);
+        return m(x, y);
+    }
+
+    HMapIntersection QDM(float2 u, float2 u2) const
+    {
+        const float2 toVirtual = HMres * (1.0f / float(1u << HMMaxMip));
+        float3 v = {(u2.x - u.x) * toVirtual.x, (u2.y - u.y) * toVirtual.y, -1.0f};
+        const bool flipX = v.x < 0, flipY = v.y < 0;
+        float2 r = {flipX ? 1 - u.x * toVirtual.x : u.x * toVirtual.x, flipY ? 1 - u.y * toVirtual.y : u.y * toVirtual.y};
+        v.x = std::abs(v.x);
+        v.y = std::abs(v.y);
+        const float2 invV = {rcpOr1e16(v.x), rcpOr1e16(v.y)};
+
+        float CurrentHeight = 1.0f;
+        uint32_t NodeX = 0, NodeY = 0, NodeCount = 1;
+        int32_t Level = (int32_t)HMMaxMip;
+        int32_t iter = 0;
+
+        while (Level >= 0 && iter < steps())
+        {
+            countStep();
+            const uint32_t sampleX = flipX ? NodeCount - 1 - NodeX : NodeX;
+            const uint32_t sampleY = flipY ? NodeCount - 1 - NodeY : NodeY;
+            const float d = loadQDMNode(pyramidMax, sampleX, sampleY, Level);
+
+            bool needDescending = true;
+            if (d < CurrentHeight)
+            {
+                const float tx = (1 - r.x) * invV.x, ty = (1 - r.y) * invV.y, tz = (CurrentHeight - d) * NodeCount;
+                const float t = std::min(tx, std::min(ty, tz));
+                const int32_t at = (ty == t ? 1 : 0) + (tz == t ? 2 : 0);
+                r = r + t * float2{v.x, v.y};
+                if (at < 2)
+                {
+                    CurrentHeight += t * v.z;
+                    NodeX += at == 0 ? 1 : 0;
+                    NodeY += at == 1 ? 1 : 0;
+                    r = {at == 0 ? 0.0f : r.x, at == 1 ? 0.0f : r.y};
+                    needDescending = false;
+                    r = 0.5f * (r + float2{float(NodeX % 2), float(NodeY % 2)});
+                    NodeCount >>= 1;
+                    NodeX >>= 1;
+                    NodeY >>= 1;
+                    v.z *= 2.0f;
+                    Level += 1;
+                }
+                else
+                {
+                    CurrentHeight = d;
+                }
+            }
+            if (needDescending)
+            {
+                NodeCount <<= 1;
+                const float2 newR = r * 2.0f;
+                NodeX = NodeX * 2 + (newR.x >= 1 ? 1 : 0);
+                NodeY = NodeY * 2 + (newR.y >= 1 ? 1 : 0);
+                r = {newR.x >= 1 ? newR.x - 1 : newR.x, newR.y >= 1 ? newR.y - 1 : newR.y};
+                v.z *= 0.5f;
+                Level--;
+            }
+            iter++;
+        }
+
+        float2 CurrentUV = lerp(u2, u, CurrentHeight);
+        float LastHeight = CurrentHeight + HMres_r.x;
+        const uint32_t tailMip = (uint32_t)std::clamp(Level + 1, 0, (int32_t)pyramidMax.getMipCount() - 1);
+        const auto sampleTail = [&](float2 uv)
+        {
+            const LayoutImage<float>& m = pyramidMax.mips[tailMip];
+            countFetches(1);
+            recordBilinear(TextureId::Pyramid, tailMip, m.width, m.height, uv);
+            return sampleBilinear(m, uv);
+        };
+        iter = 0;
+        while (sampleTail(CurrentUV) < CurrentHeight && iter < steps())
+        {
+            countStep();
+            LastHeight = CurrentHeight;
+            const float tx = (1 - r.x) * invV.x, ty = (1 - r.y) * invV.y;
+            const float t = std::min(tx, ty);
+            const int32_t at = t == ty ? 1 : 0;
+            CurrentHeight += t * v.z;
+            r = r + t * float2{v.x, v.y} - float2{at == 0 ? 1.0f : 0.0f, at == 1 ? 1.0f : 0.0f};
+            CurrentUV = lerp(u2, u, CurrentHeight);
+            iter++;
+        }
+
+        HMapIntersection ret;
+        ret.t = 1.0f - CurrentHeight;
+        ret.uv = CurrentUV;
+        ret.last_t = 1.0f - LastHeight;
+        ret.wasHit = Level < 0;
+        return ret;
+    }
+
+    // loadH and texelCenter of Parallax.ps.slang: the texel that getH filters, clamped like the sampler
+    float loadH(int32_t x, int32_t y) const
+    {
+        const uint32_t cx = std::clamp(x, 0, (int32_t)heights.width - 1), cy = std::clamp(y, 0, (int32_t)heights.height - 1);
+        switch (settings.selectedParallaxFun)
+        {
+        case 3:
+        case 13: recordTexel(TextureId::ConeMap, 0, cx, cy); return coneMap(cx, cy).x;
+        case 10:
+        case 11:
+        case 12: recordTexel(TextureId::Pyramid, 0, cx, cy); return pyramidMax.mips[0](cx, cy);
+        case 14: return proceduralHeight(proceduralSettings, {(cx + 0.5f) * HMres_r.x, (cy + 0.5f) * HMres_r.y});
+        default: recordTexel(TextureId::Heightmap, 0, cx, cy); return heights(cx, cy);
+        }
+    }
+    float texelCenter() const { return settings.selectedParallaxFun == 10 ? 0.0f : 0.5f; }
+
+    // intersectBilinearCells of FindIntersection.slang
+    bool intersectBilinearCells(float& t, float2 u, float2 u2, float tEnter, float tExit, uint32_t maxCells, uint32_t& cellCount) const
+    {
+        t = std::numeric_limits<float>::infinity();
+        cellCount = 0;
+        const float2 p0 = u * HMres;
+        const float2 dir = (u2 - u) * HMres;
+        const float2 invDir = {rcpOr1e16(dir.x), rcpOr1e16(dir.y)};
+        const bool positiveX = dir.x >= 0, positiveY = dir.y >= 0;
+
+        const float center = texelCenter();
+        const float2 pEnter = p0 + tEnter * dir - float2{center, center};
+        int32_t cellX = int32_t(positiveX ? std::floor(pEnter.x) : std::ceil(pEnter.x) - 1);
+        int32_t cellY = int32_t(positiveY ? std::floor(pEnter.y) : std::ceil(pEnter.y) - 1);
+
+        const auto corner = [&](int32_t x, int32_t y) { return float3{x + center, y + center, loadH(x, y)}; };
+        for (; cellCount < maxCells; ++cellCount)
+        {
+            countFetches(4);
+            if (intersectBilinearPatch(t, corner(cellX, cellY), corner(cellX, cellY + 1), corner(cellX + 1, cellY), corner(cellX + 1, cellY + 1),
+                                       float3{p0.x, p0.y, 1.0f}, float3{p0.x + dir.x, p0.y + dir.y, 0.0f}, patchMinT()))
+            {
+                ++cellCount;
+                return true;
+            }
+
+            const float tCellX = (cellX + center + (positiveX ? 1 : 0) - p0.x) * invDir.x;
+            const float tCellY = (cellY + center + (positiveY ? 1 : 0) - p0.y) * invDir.y;
+            const float tNext = std::min(tCellX, tCellY);
+            if (tNext >= tExit)
+            {
+                ++cellCount;
+                break;
+            }
+            cellX += tCellX == tNext ? (positiveX ? 1 : -1) : 0;
+            cellY += tCellY == tNext ? (positiveY ? 1 : -1) : 0;
+        }
+        return false;
+    }
+
+    // intersectTexelCells of FindIntersection.slang
+    bool intersectTexelCells(float& t, int32_t texelX, int32_t texelY, float2 u, float2 u2) const
+    {
+        const float2 p0 = u * HMres;
+        const float2 dir = (u2 - u) * HMres;
+        const float2 invDir = {rcpOr1e16(dir.x), rcpOr1e16(dir.y)};
+
+        const float tAx = (texelX - p0.x) * invDir.x, tAy = (texelY - p0.y) * invDir.y;
+        const float tBx = (texelX + 1 - p0.x) * invDir.x, tBy = (texelY + 1 - p0.y) * invDir.y;
+        const float tEnter = std::max(rayStartT, std::max(std::min(tAx, tBx), std::min(tAy, tBy)));
+        const float tExit = std::min(1.0f, std::min(std::max(tAx, tBx), std::max(tAy, tBy)));
+        uint32_t cellCount;
+        return intersectBilinearCells(t, u, u2, tEnter, tExit, 3, cellCount);
+    }
+
+    HMapIntersection QDMBilinear(float2 u, float2 u2) const
+    {
+        const float2 toVirtual = HMres * (1.0f / float(1u << HMMaxMip));
+        float3 v = {(u2.x - u.x) * toVirtual.x, (u2.y - u.y) * toVirtual.y, -1.0f};
+        const bool flipX = v.x < 0, flipY = v.y < 0;
+        const float2 start = rayStartT > 0 ? lerp(u, u2, rayStartT) : u;
+        float2 r = {flipX ? 1 - start.x * toVirtual.x : start.x * toVirtual.x, flipY ? 1 - start.y * toVirtual.y : start.y * toVirtual.y};
+        v.x = std::abs(v.x);
+        v.y = std::abs(v.y);
+        const float2 invV = {rcpOr1e16(v.x), rcpOr1e16(v.y)};
+
+        float CurrentHeight = 1.0f - rayStartT;
+        float LastHeight = CurrentHeight;
+        uint32_t NodeX = 0, NodeY = 0, NodeCount = 1;
+        int32_t Level = (int32_t)HMMaxMip;
+        int32_t iter = 0;
+        bool wasHit = false;
+
+        while (iter < steps())
+        {
+            countStep();
+            const uint32_t sampleX = flipX ? NodeCount - 1 - NodeX : NodeX;
+            const uint32_t sampleY = flipY ? NodeCount - 1 - NodeY : NodeY;
+            const float d = loadQDMNode(pyramidBorderMax, sampleX, sampleY, Level);
+
+            int32_t at = 2;
+            float t = 0.0f;
+            if (d < CurrentHeight)
+            {
+                const float tx = (1 - r.x) * invV.x, ty = (1 - r.y) * invV.y, tz = (CurrentHeight - d) * NodeCount;
+                t = std::min(tx, std::min(ty, tz));
+                at = (ty == t ? 1 : 0) + (tz == t ? 2 : 0);
+            }
+
+            if (at == 2 && Level == 0)
+            {
+                float tHit;
+                if (intersectTexelCells(tHit, (int32_t)sampleX, (int32_t)sampleY, u, u2))
+                {
+                    LastHeight = CurrentHeight;
+                    CurrentHeight = 1.0f - tHit;
+                    wasHit = true;
+                    break;
+                }
+                const float tx = (1 - r.x) * invV.x, ty = (1 - r.y) * invV.y;
+                t = std::min(tx, ty);
+                at = t == ty ? 1 : 0;
+            }
+
+            r = r + t * float2{v.x, v.y};
+            if (at < 2)
+            {
+                CurrentHeight += t * v.z;
+                NodeX += at == 0 ? 1 : 0;
+                NodeY += at == 1 ? 1 : 0;
+                r = {at == 0 ? 0.0f : r.x, at == 1 ? 0.0f : r.y};
+                r = 0.5f * (r + float2{float(NodeX % 2), float(NodeY % 2)});
+                NodeCount >>= 1;
+                NodeX >>= 1;
+                NodeY >>= 1;
+                v.z *= 2.0f;
+                Level += 1;
+                if (NodeX >= NodeCount || NodeY >= NodeCount)
+                {
+                    CurrentHeight = 0.0f;
+                    break;
+                }
+            }
+            else
+            {
+                CurrentHeight = std::min(CurrentHeight, d);
+                NodeCount <<= 1;
+                const float2 newR = r * 2.0f;
+                NodeX = NodeX * 2 + (newR.x >= 1 ? 1 : 0);
+                NodeY = NodeY * 2 + (newR.y >= 1 ? 1 : 0);
+                r = {newR.x >= 1 ? newR.x - 1 : newR.x, newR.y >= 1 ? newR.y - 1 : newR.y};
+                v.z *= 0.5f;
+                Level--;
+            }
+            iter++;
+        }
+
+        HMapIntersection ret;
+        ret.t = 1.0f - CurrentHeight;
+        ret.uv = lerp(u2, u, CurrentHeight);
+        ret.last_t = 1.0f - LastHeight;
+        ret.wasHit = wasHit;
+        return ret;
+    }
+
+    // MaxMipTexture.Load, out of bounds loads return 0 without reading memory
+    float loadMaxMip(const FloatMips& pyramid, uint32_t x, uint32_t y, int32_t mip) const
+    {
+        if (mip < (int32_t)pyramid.getMipCount() && x < pyramid.mips[mip].width && y < pyramid.mips[mip].height)
+            recordTexel(TextureId::Pyramid, (uint32_t)mip, x, y);
+        return pyramid.load((int32_t)x, (int32_t)y, (uint32_t)mip);
+    }
+
+    HMapIntersection MaxMip(float2 u, float2 u2) const
+    {
+        float3 v = {u2.x - u.x, u2.y - u.y, -1.0f};
+        const bool flipX = v.x < 0, flipY = v.y < 0;
+        const float2 start = rayStartT > 0 ? lerp(u, u2, rayStartT) : u;
+        float3 r = {flipX ? 1 - start.x : start.x, flipY ? 1 - start.y : start.y, 1.0f - rayStartT};
+        v.x = std::abs(v.x);
+        v.y = std::abs(v.y);
+        const float2 invV = {rcpOr1e16(v.x), rcpOr1e16(v.y)};
+
+        uint32_t NodeX = 0, NodeY = 0, NodeCount = 1;
+        int32_t Level = (int32_t)HMMaxMip;
+        int32_t iter = 0;
+
+        while (iter < steps())
+        {
+            countStep();
+            countFetches(1);
+            const uint32_t sampleX = flipX ? NodeCount - 1 - NodeX : NodeX;
+            const uint32_t sampleY = flipY ? NodeCount - 1 - NodeY : NodeY;
+            const float height = loadMaxMip(pyramidCellMax, sampleX, sampleY, std::max(Level, 1) - 1);
+            const bool rayAboveHeightField = r.z > height;
+
+            if (Level == 0 && !rayAboveHeightField)
+            {
+                const auto corner = [&](uint32_t x, uint32_t y) { return float3{float(x), float(y), loadMaxMip(pyramidMax, x, y, 0)}; };
+                countFetches(4);
+                float t;
+                if (intersectBilinearPatch(t, corner(sampleX, sampleY), corner(sampleX, sampleY + 1), corner(sampleX + 1, sampleY), corner(sampleX + 1, sampleY + 1),
+                                           float3{u.x * HMres.x, u.y * HMres.y, 1.0f}, float3{u2.x * HMres.x, u2.y * HMres.y, 0.0f}, patchMinT()))
+                {
+                    r.z = 1.0f - t;
+                    break;
+                }
+            }
+
+            if (rayAboveHeightField || Level == 0)
+            {
+                const float tx = ((NodeX + 1) * (1.0f / NodeCount) - r.x) * invV.x;
+                const float ty = ((NodeY + 1) * (1.0f / NodeCount) - r.y) * invV.y;
+                float tz = r.z - height;
+                if (tz <= 0.0f)
+                    tz = 1e16f;
+                const float t = std::min(tx, std::min(ty, tz));
+                r = r + t * v;
+
+                uint32_t argmin = 0;
+                if (ty == t)
+                    argmin = 1;
+                if (tz == t)
+                    argmin = 2;
+                NodeX += argmin == 0 ? 1 : 0;
+                NodeY += argmin == 1 ? 1 : 0;
+
+                if (Level > 0 && argmin < 2 && NodeX % 2 == 0 && NodeY % 2 == 0)
+                {
+                    NodeCount >>= 1;
+                    NodeX /= 2;
+                    NodeY /= 2;
+                    Level++;
+                }
+            }
+            else
+            {
+                if (Level > 1)
+                {
+                    NodeCount <<= 1;
+                    NodeX *= 2;
+                    NodeY *= 2;
+                    if (r.x >= (NodeX + 1) * (1.0f / NodeCount))
+                        NodeX++;
+                    if (r.y >= (NodeY + 1) * (1.0f / NodeCount))
+                        NodeY++;
+                }
+                Level--;
+            }
+            iter++;
+        }
+
+        HMapIntersection ret;
+        ret.t = 1.0f - r.z;
+        ret.uv = lerp(u, u2, ret.t);
+        ret.wasHit = iter < steps();
+        return ret;
+    }
+
+    // maxMipFrom of FindIntersection.slang: the Maximum Mip traversal of findIntersection_coneStepMaxMip from ray
+    // parameter t0, on the surface of the texel centers (the ray is shifted by half a texel into the corner space
+    // of the pyramid). Ends with a hit, out of steps, or not hit where the ray leaves the pyramid's grid.
+    HMapIntersection maxMipFrom(float2 u, float2 u2, float t0, float footprint, int32_t& iter) const
+    {
+        const float2 uc = u - 0.5f * HMres_r, uc2 = u2 - 0.5f * HMres_r;
+        float3 v = {uc2.x - uc.x, uc2.y - uc.y, -1.0f};
+        const bool flipX = v.x < 0, flipY = v.y < 0;
+        const float2 p = lerp(uc, uc2, t0);
+        float3 r = {flipX ? 1 - p.x : p.x, flipY ? 1 - p.y : p.y, 1.0f - t0};
+        v.x = std::abs(v.x);
+        v.y = std::abs(v.y);
+        const float2 invV = {rcpOr1e16(v.x), rcpOr1e16(v.y)};
+
+        // the level whose nodes are as large as the last cone step
+        int32_t Level = std::clamp(int32_t(std::floor(std::log2(std::max(footprint * HMres.x, 1.0f)))) + 1, 1, (int32_t)HMMaxMip);
+        uint32_t NodeCount = 1u << (HMMaxMip - Level);
+        uint32_t NodeX = std::min(uint32_t(r.x * NodeCount), NodeCount - 1);
+        uint32_t NodeY = std::min(uint32_t(r.y * NodeCount), NodeCount - 1);
+        float lastZ = r.z;
+        bool wasHit = false;
+
+        while (iter < steps())
+        {
+            countStep();
+            countFetches(1);
+            const uint32_t sampleX = flipX ? NodeCount - 1 - NodeX : NodeX;
+            const uint32_t sampleY = flipY ? NodeCount - 1 - NodeY : NodeY;
+            const float height = loadMaxMip(pyramidCellMax, sampleX, sampleY, std::max(Level, 1) - 1);
+            const bool rayAboveHeightField = r.z > height;
+
+            if (Level == 0 && !rayAboveHeightField)
+            {
+                // clamped like the bilinear filtering of the cone map
+                const auto corner = [&](uint32_t x, uint32_t y)
+                { return float3{float(x), float(y), loadMaxMip(pyramidMax, std::min(x, heights.width - 1), std::min(y, heights.height - 1), 0)}; };
+                countFetches(4);
+                float t;
+                if (intersectBilinearPatch(t, corner(sampleX, sampleY), corner(sampleX, sampleY + 1), corner(sampleX + 1, sampleY), corner(sampleX + 1, sampleY + 1),
+                                           float3{uc.x * HMres.x, uc.y * HMres.y, 1.0f}, float3{uc2.x * HMres.x, uc2.y * HMres.y, 0.0f}))
+                {
+                    lastZ = r.z;
+                    r.z = 1.0f - t;
+                    wasHit = true;
+                    iter++;
+                    break;
+                }
+            }
+
+            if (rayAboveHeightField || Level == 0)
+            {
+                const float tx = ((NodeX + 1) * (1.0f / NodeCount) - r.x) * invV.x;
+                const float ty = ((NodeY + 1) * (1.0f / NodeCount) - r.y) * invV.y;
+                float tz = r.z - height;
+                if (tz <= 0.0f)
+                    tz = 1e16f;
+                const float t = std::min(tx, std::min(ty, tz));
+                r = r + t * v;
+                lastZ = r.z;
+
+                uint32_t argmin = 0;
+                if (ty == t)
+                    argmin = 1;
+                if (tz == t)
+                    argmin = 2;
+                NodeX += argmin == 0 ? 1 : 0;
+                NodeY += argmin == 1 ? 1 : 0;
+                if (NodeX >= NodeCount || NodeY >= NodeCount)
+                {
+                    iter++;
+                    break;
+                }
+
+                if (Level > 0 && argmin < 2 && NodeX % 2 == 0 && NodeY % 2 == 0)
+                {
+                    NodeCount >>= 1;
+                    NodeX /= 2;
+                    NodeY /= 2;
+                    Level++;
+                }
+            }
+            else
+            {
+                if (Level > 1)
+                {
+                    NodeCount <<= 1;
+                    NodeX *= 2;
+                    NodeY *= 2;
+                    if (r.x >= (NodeX + 1) * (1.0f / NodeCount))
+                        NodeX++;
+                    if (r.y >= (NodeY + 1) * (1.0f / NodeCount))
+                        NodeY++;
+                }
+                Level--;
+            }
+            iter++;
+        }
+
+        HMapIntersection ret;
+        ret.t = 1.0f - r.z;
+        ret.uv = lerp(u, u2, ret.t);
+        ret.last_t = 1.0f - lastZ;
+        ret.wasHit = wasHit;
+        return ret;
+    }
+
+    // findIntersection_coneStepMaxMip: cone steps until a step is shorter than hybridMinStep texels or
+    // hybridConeSteps are used, then the Maximum Mip traversal from the last point above the surface
+    HMapIntersection coneStepMaxMip(float2 u, float2 u2) const
+    {
+        const float3 ds = normalize(float3{u2.x - u.x, u2.y - u.y, 1});
+        float w = 1 / HMres.x;
+        const float iz = std::sqrt(1.0f - ds.z * ds.z);
+        float sc = 0;
+        float lastStep = 1;
+        float2 t = getHC(u);
+        int32_t stepCount = 0;
+        float zTimesSc = 0;
+        const float2 dirSign = {(ds.x < 0 ? -0.5f : 0.5f) / HMres.x, (ds.y < 0 ? -0.5f : 0.5f) / HMres.y};
+        bool canSwitch = true;
+        // a ray that left the texture cannot come back: it ends on the bottom of the volume, outside
+        const auto leftTexture = [&](float lastT)
+        {
+            HMapIntersection ret;
+            ret.last_t = lastT;
+            ret.wasHit = true;
+            ret.t = 1;
+            ret.uv = u2;
+            return ret;
+        };
+
+        while (1.0f - ds.z * sc > t.x && stepCount < steps())
+        {
+            const float2 p = u + float2{ds.x, ds.y} * sc;
+            if (isOutside(p))
+                return leftTexture(ds.z * sc);
+            // the pyramid's grid starts half a texel in: texel centers are its corners
+            const float2 pc = p * HMres - float2{0.5f, 0.5f};
+            const bool inGrid = pc.x >= 0 && pc.y >= 0 && pc.x <= HMres.x && pc.y <= HMres.y;
+            if (canSwitch && inGrid && (stepCount >= (int32_t)settings.hybridConeSteps || lastStep * HMres.x < settings.hybridMinStep))
+            {
+                canSwitch = false;
+                const HMapIntersection mm = maxMipFrom(u, u2, ds.z * sc, lastStep, stepCount);
+                if (mm.wasHit || stepCount >= steps())
+                    return mm;
+                if (isOutside(mm.uv))
+                    return leftTexture(mm.t);
+                // left the grid into the half texel border before the low edges, which cone steps cover
+                sc = mm.t / ds.z;
+                t = getHC(u + float2{ds.x, ds.y} * sc);
+                continue;
+            }
+            countStep();
+            zTimesSc = ds.z * sc;
+            if (settings.CONSERVATIVE_STEP)
+            {
+                const float2 cellCenter = {(std::floor(p.x * HMres.x - .5f) + 1) / HMres.x, (std::floor(p.y * HMres.y - .5f) + 1) / HMres.y};
+                const float2 wall = cellCenter + dirSign;
+                w = std::min((wall.x - p.x) / ds.x, (wall.y - p.y) / ds.y) + 1e-5f;
+            }
+            lastStep = settings.relax * std::max(w, (1.0f - zTimesSc - t.x) * t.y / (t.y * ds.z + iz));
+            sc += lastStep;
+            t = getHC(u + float2{ds.x, ds.y} * sc);
+            ++stepCount;
+        }
+
+        HMapIntersection ret;
+        ret.last_t = zTimesSc;
+        ret.wasHit = stepCount < steps();
+        ret.t = ds.z * sc;
+        ret.uv = (1 - ret.t) * u + ret.t * u2;
+        return ret;
+    }
+
+    // findIntersection_procedural
+    HMapIntersection procedural(float2 u, float2 u2) const
+    {
+        const float2 d = u2 - u;
+        float tExit = 1;
+        if (d.x != 0)
+            tExit = std::min(tExit, ((d.x > 0 ? 1.0f : 0.0f) - u.x) / d.x);
+        if (d.y != 0)
+            tExit = std::min(tExit, ((d.y > 0 ? 1.0f : 0.0f) - u.y) / d.y);
+        tExit = std::max(tExit, 0.0f);
+        const float texelDt = 1 / std::max(rayTexels, std::max(HMres.x, HMres.y));
+
+        HMapIntersection ret;
+        float t = 0;
+        float lastT = 0;
+        float dt = 1.0f / 16;
+        for (uint32_t i = 0; i < rayStepNum; ++i)
+        {
+            countStep();
+            const float t1 = std::min(t + dt, tExit);
+            const float2 p0 = u + d * t, p1 = u + d * t1;
+            if (1 - t1 >= proceduralMaxHeight(proceduralSettings, {std::min(p0.x, p1.x), std::min(p0.y, p1.y)}, {std::max(p0.x, p1.x), std::max(p0.y, p1.y)}))
+            {
+                lastT = t;
+                t = t1;
+                if (t >= tExit)
+                {
+                    if (tExit < 1)
+                    {
+                        ret.last_t = t;
+                        ret.wasHit = true;
+                        ret.t = 1;
+                        ret.uv = u2;
+                        return ret;
+                    }
+                    ret.wasHit = true;
+                    break;
+                }
+                dt *= 2;
+            }
+            else if (t1 - t <= kProceduralMinStep * texelDt || (t1 - t <= texelDt && getH(p1) >= 1 - t1))
+            {
+                lastT = t;
+                t = t1;
+                ret.wasHit = true;
+                break;
+            }
+            else
+                dt = 0.5f * (t1 - t);
+        }
+        ret.t = t;
+        ret.last_t = lastT;
+        ret.uv = u + d * t;
+        return ret;
+    }
+
+    HMapIntersection findIntersection(float2 u, float2 u2) const
+    {
+        switch (settings.selectedParallaxFun)
+        {
+        case 0: return bumpMapping(u, u2);
+        case 1: return parallaxMapping(u, u2);
+        case 2: return linearSearch(u, u2);
+        case 3: return coneStepMapping(u, u2);
+        case 10: return MaxMip(u, u2);
+        case 11: return QDM(u, u2);
+        case 12: return QDMBilinear(u, u2);
+        case 13: return coneStepMaxMip(u, u2);
+        case 14: return procedural(u, u2);
+        default: return bumpMapping(u, u2);
+        }
+    }
+
+    // pT: also the refined position along the ray, uv = lerp(u0, u1, t)
+    float2 refineIntersection(const HMapIntersection& interval, float2 u0, float2 u1, float* pT = nullptr) const
+    {
+        float t0 = interval.last_t;
+        float t1 = interval.t;
+        float tmp;
+        float& tOut = pT ? *pT : tmp;
+        tOut = interval.t;
+        if (settings.selectedRefinementFun != 0 && isResolved(t0, t1))
+            return interval.uv;
+        if (settings.selectedRefinementFun == 1)
+        {
+            countRefineStep();
+            const float h0 = getH(lerp(u0, u1, t0));
+            const float h1 = getH(lerp(u0, u1, t1));
+            const float dt = t1 - t0;
+            const float t = std::clamp((dt + t0 * h1 - t1 * h0) / (dt + h1 - h0), t0, t1);
+            tOut = t;
+            return lerp(u0, u1, t);
+        }
+        if (settings.selectedRefinementFun == 2)
+        {
+            float th = 0.5f * (t0 + t1);
+            for (uint32_t i = 0; i < settings.refineStepNum && !isResolved(t0, t1); ++i)
+            {
+                countRefineStep();
+                if (getH(lerp(u0, u1, th)) > 1 - th)
+                    t1 = th;
+                else
+                    t0 = th;
+                th = 0.5f * (t0 + t1);
+            }
+            tOut = th;
+            return lerp(u0, u1, th);
+        }
+        if (settings.selectedRefinementFun == 3)
+        {
+            // refineIntersection_secant: Illinois steps, a bisection after a step that does not halve the interval
+            countRefineStep();
+            float f0 = getH(lerp(u0, u1, t0)) - (1 - t0);
+            float f1 = getH(lerp(u0, u1, t1)) - (1 - t1);
+            int side = -1;
+            bool bisect = false;
+            for (uint32_t i = 0; i < settings.refineStepNum && (t1 - t0) * rayTexels > settings.refineEpsilon && !isResolved(t0, t1); ++i)
+            {
+                countRefineStep();
+                const float width = t1 - t0;
+                const float t = bisect ? 0.5f * (t0 + t1) : secantRoot(t0, t1, f0, f1);
+                const float f = getH(lerp(u0, u1, t)) - (1 - t);
+                if (f > 0)
+                {
+                    t1 = t;
+                    f1 = f;
+                    if (side == 1)
+                        f0 *= 0.5f;
+                    side = 1;
+                }
+                else
+                {
+                    t0 = t;
+                    f0 = f;
+                    if (side == 0)
+                        f1 *= 0.5f;
+                    side = 0;
+                }
+                bisect = t1 - t0 > 0.5f * width;
+            }
+            tOut = secantRoot(t0, t1, f0, f1);
+            return lerp(u0, u1, tOut);
+        }
+        if (settings.selectedRefinementFun == 4)
+        {
+            // refineIntersection_bilinearPatch: the cells between the last two steps, intersected exactly
+            float t;
+            uint32_t cellCount;
+            const bool hit = intersectBilinearCells(t, u0, u1, t0, t1, settings.refineStepNum, cellCount);
+            if (stats)
+                stats->refineSteps += cellCount;
+            if (!hit)
+                return interval.uv;
+            tOut = t;
+            return lerp(u0, u1, t);
+        }
+        return interval.uv;
+    }
+    // where the line through (t0, f0) and (t1, f1) crosses zero; the midpoint if they do not bracket a crossing
+    static float secantRoot(float t0, float t1, float f0, float f1)
+    {
+        return f1 > f0 ? std::clamp(t0 - f0 * (t1 - t0) / (f1 - f0), t0, t1) : 0.5f * (t0 + t1);
+    }
+
+    float3 getNormalTBN(float2 uv) const
+    {
+        const float2 du = {HMres_r.x, 0}, dv = {0, HMres_r.y};
+        const float dhdu = 0.5f * HMres.x * (sampleH(uv + du) - sampleH(uv - du));
+        const float dhdv = 0.5f * HMres.y * (sampleH(uv + dv) - sampleH(uv - dv));
+        return normalize(float3{-dhdu, -dhdv, 1});
+    }
+
+    static bool isOutside(float2 u3) { return u3.x < 0 || u3.y < 0 || u3.x > 1 || u3.y > 1; }
+    static TraceState getState(const HMapIntersection& I, float2 u3)
+    {
+        return isOutside(u3) ? TraceState::Missed : I.wasHit ? TraceState::Hit : TraceState::NotConverged;
+    }
+
+    // Shadow.slang: the shadow ray from the hit (uv, h) towards the light, l in tangent space
+    float shadowLinearSearch(float2 uv, float h, float3 l) const
+    {
+        const float2 slope = float2{l.x, l.y} / l.z;
+        const uint32_t n = std::max(1u, uint32_t(std::ceil(rayStepNum * (1 - h))));
+        const float dz = (1 - h) / n;
+        for (uint32_t i = 1; i <= n; ++i)
+        {
+            countStep();
+            const float z = h + i * dz;
+            const float2 p = uv + slope * (z - h);
+            if (isOutside(p))
+                return 1;
+            if (getH(p) > z)
+                return 0;
+        }
+        return 1;
+    }
+    // getShadowCone: the bilinear height and the narrowest of the four cones, with two gathers
+    float2 getShadowCone(float2 uv) const
+    {
+        countFetches(2);
+        recordBilinear(TextureId::ConeMap, 0, coneMap.width, coneMap.height, uv);
+        const float fx = std::floor(uv.x * coneMap.width - 0.5f), fy = std::floor(uv.y * coneMap.height - 0.5f);
+        const auto clampX = [&](float v) { return (uint32_t)std::clamp(v, 0.0f, float(coneMap.width - 1)); };
+        const auto clampY = [&](float v) { return (uint32_t)std::clamp(v, 0.0f, float(coneMap.height - 1)); };
+        float ratio = coneMap(clampX(fx), clampY(fy)).y;
+        ratio = std::min(ratio, coneMap(clampX(fx + 1), clampY(fy)).y);
+        ratio = std::min(ratio, coneMap(clampX(fx), clampY(fy + 1)).y);
+        ratio = std::min(ratio, coneMap(clampX(fx + 1), clampY(fy + 1)).y);
+        return {sampleBilinear(coneMap, uv).x, ratio};
+    }
+    float shadowConeStep(float2 uv, float h, float3 l) const
+    {
+        const float2 slope = float2{l.x, l.y} / l.z;
+        const float a = std::sqrt(slope.x * slope.x + slope.y * slope.y);
+        const float minDz = kShadowMinStep * HMres_r.x / std::max(a, 1e-6f);
+        float visibility = 1;
+        float z = h;
+        for (uint32_t i = 0; i < rayStepNum && z < 1; ++i)
+        {
+            countStep();
+            const float2 p = uv + slope * (z - h);
+            if (isOutside(p))
+                break;
+            const float2 cone = getShadowCone(p);
+            const float above = z - cone.x;
+            if (above < 0 && i > 0)
+                return 0;
+            if (settings.selectedShadowFun == 3 && i > 0)
+                visibility = std::min(visibility, cone.y * above / (settings.shadowSoftness * a * (z - h)));
+            if (a <= cone.y)
+                break;
+            z += std::max(minDz, cone.y * std::max(above, 0.0f) / (a - cone.y));
+        }
+        return saturate(visibility);
+    }
+    float traceShadow(float2 uv, float3 l) const
+    {
+        if (settings.selectedShadowFun == 0)
+            return 1;
+        if (l.z <= 0)
+            return 0;
+        const float h = getH(uv);
+        return settings.selectedShadowFun == 1 ? shadowLinearSearch(uv, h, l) : shadowConeStep(uv, h, l);
+    }
+
+    // the rest of main() on the found intersection; false: discard
+    // pT: also the refined position along the ray
+    bool shade(float3& col, const HMapIntersection& I, float2 u, float2 u2, float* pT = nullptr) const
+    {
+        const float2 u3 = refineIntersection(I, u, u2, pT);
+        const bool outside = isOutside(u3);
+        if (stats)
+            stats->state = getState(I, u3);
+
+        col = {.5f, .5f, .5f};
+        if (outside)
+        {
+            if (settings.discardFragments)
+                return false;
+            col = {1, 0, 0};
+            return true;
+        }
+
+        const float3 normT = getNormalTBN(u3);
+        const float3 norm = normalize(r1 * normT.x + r2 * normT.y + r3 * normT.z);
+        if (!albedo.empty())
+            col = col * sampleBilinear(albedo, u3);
+
+        float diffuse = settings.lightIntensity * saturate(dot(-normalize(settings.lightDir), norm));
+        if (settings.selectedShadowFun != 0 && diffuse > 0)
+        {
+            const float3 l = -settings.lightDir;
+            diffuse *= traceShadow(u3, {dot(r1, l), dot(r2, l), dot(r3, l)});
+        }
+        col = col * diffuse;
+
+        if (settings.displayNonConverged && !I.wasHit)
+            col = {1, 0, 1};
+        return true;
+    }
+};
+
+// The FScb constants of the settings, without the tangent frame
+PixelShader makeShader(const RenderSettings& settings, const LayoutImage<float>& heights, const ConeTexture& coneMap, const FloatMips& pyramidMax,
+                       const FloatMips& pyramidCellMax, const FloatMips& pyramidBorderMax, const Image<float3>& albedo,
+                       const ProceduralHeightSettings& proceduralSettings)
+{
+    PixelShader shader{settings, heights, coneMap, pyramidMax, pyramidCellMax, pyramidBorderMax, albedo, proceduralSettings};
+    shader.HMres = {float(heights.width), float(heights.height)};
+    shader.HMres_r = {1.0f / heights.width, 1.0f / heights.height};
+    shader.rayStepNum = settings.stepNum;
+    if (settings.selectedParallaxFun == 10 || settings.selectedParallaxFun == 13)
+        shader.HMMaxMip = pyramidMax.getMipCount(); // level 0 is the heightmap
+    else
+        while ((1u << shader.HMMaxMip) < std::max(heights.width, heights.height))
+            ++shader.HMMaxMip;
+    return shader;
+}
+
+// The square of onFrameRender seen by one camera: the camera rays of the pixels and the tangent frame
+struct SquareView
+{
+    uint32_t width, height;
+    // model = translate * rotate * scale of the unit square on y = 0, texC = (x, z) * 0.5 + 0.5
+    float3 axis, scale;
+    float angle;
+    // rows of the inverse of the [T B N] column matrix (invMat)
+    float3 r1, r2, r3;
+    bool mirrored;
+    float3 N, translate;
+    float3 forward, right, up, camPos, camModel;
+    float tanHalfFov, aspect;
+
+    SquareView(const RenderSettings& settings, const CameraSettings& camera, uint32_t w, uint32_t h)
+        : width(w), height(h), axis(normalize(settings.axis)), scale(settings.scale), angle(settings.angle), translate(settings.translate), camPos(camera.position)
+    {
+        const float3 T = toWorld({2, 0, 0});
+        const float3 B = toWorld({0, 0, 2});
+        N = normalize(rotate(float3{0, 1 / scale.y, 0}, angle, axis)) * settings.heightMapHeight;
+        // back face culling: the top of the square is the front face, mirrored by a negative determinant
+        mirrored = scale.x * scale.y * scale.z < 0;
+        const float invDet = 1 / dot(cross(T, B), N);
+        r1 = cross(B, N) * invDet;
+        r2 = cross(N, T) * invDet;
+        r3 = cross(T, B) * invDet;
+
+        forward = normalize(camera.target - camera.position);
+        right = normalize(cross(forward, camera.up));
+        up = cross(right, forward);
+        tanHalfFov = std::tan(0.5f * camera.fovY);
+        aspect = float(width) / height;
+        camModel = toModel(camera.position - settings.translate);
+    }
+
+    float3 toWorld(float3 v) const { return rotate(v * scale, angle, axis); }
+    float3 toModel(float3 v) const
+    {
+        const float3 r = rotate(v, -angle, axis);
+        return float3{r.x / scale.x, r.y / scale.y, r.z / scale.z};
+    }
+
+    // The view direction through continuous pixel coordinates (px, py), pixel centers at +0.5
+    float3 getDir(float px, float py) const
+    {
+        const float ndcX = 2 * px / width - 1, ndcY = 1 - 2 * py / height;
+        return forward + right * (ndcX * tanHalfFov * aspect) + up * (ndcY * tanHalfFov);
+    }
+    float3 getDir(uint32_t x, uint32_t y) const { return getDir(x + 0.5f, y + 0.5f); }
+
+    // The ray of pixel (x, y) through the height field volume; false: the pixel is not on the square
+    bool castRay(uint32_t x, uint32_t y, ConeStepRay& ray) const { return castRay(x + 0.5f, y + 0.5f, ray); }
+    // The ray through continuous pixel coordinates, for the sub-samples of supersampling
+    bool castRay(float px, float py, ConeStepRay& ray) const
+    {
+        const float3 dir = getDir(px, py);
+        const float3 dirModel = toModel(dir);
+        if (dirModel.y == 0 || ((dirModel.y > 0) != mirrored))
+            return false;
+        const float t = -camModel.y / dirModel.y;
+        const float3 q = camModel + t * dirModel;
+        if (t <= 0 || std::abs(q.x) > 1 || std::abs(q.z) > 1)
+            return false;
+
+        // main() of Parallax.ps.slang up to findIntersection: the bottom plate point of the view ray
+        ray.u = {q.x * 0.5f + 0.5f, q.z * 0.5f + 0.5f};
+        const float3 viewDirW = (camPos + t * dir) - camPos;
+        const float3 viewDirT = {dot(r1, viewDirW), dot(r2, viewDirW), dot(r3, viewDirW)};
+        ray.u2 = ray.u - float2{viewDirT.x, viewDirT.y} / viewDirT.z;
+        return true;
+    }
+
+    // The world position of the height field at texture coordinates uv and height h; the square is the top plate
+    float3 toWorldPoint(float2 uv, float h) const { return translate + toWorld({2 * uv.x - 1, 0, 2 * uv.y - 1}) + N * (h - 1); }
+
+    // The continuous pixel coordinates of a world position (pixel centers at +0.5); false: behind the camera
+    bool project(float3 p, float2& pixel) const
+    {
+        const float3 d = p - camPos;
+        const float z = dot(d, forward);
+        if (z <= 0)
+            return false;
+        const float ndcX = dot(d, right) / (z * tanHalfFov * aspect), ndcY = dot(d, up) / (z * tanHalfFov);
+        pixel = {(ndcX + 1) * 0.5f * width, (1 - ndcY) * 0.5f * height};
+        return true;
+    }
+
+    // The texels pixel (x, y) covers on the square, max(length(ddx(u)), length(ddy(u))) * HMres of main(),
+    // from the texture coordinates of the plane of the square at the next pixels
+    float getFootprint(uint32_t x, uint32_t y, float2 u, float2 HMres) const
+    {
+        const auto texels = [&](uint32_t nx, uint32_t ny)
+        {
+            const float3 dirModel = toModel(getDir(nx, ny));
+            const float3 q = camModel + (-camModel.y / dirModel.y) * dirModel;
+            const float2 d = (float2{q.x * 0.5f + 0.5f, q.z * 0.5f + 0.5f} - u) * HMres;
+            return std::sqrt(d.x * d.x + d.y * d.y);
+        };
+        return std::max(texels(x + 1, y), texels(x, y + 1));
+    }
+};
+
+// The ray parameter t of the last frame's hits at the pixels of this one: every hit is splatted onto the 2x2 pixels
+// around its projection with t = 1 - its height, and the smallest t (the highest hit) of a pixel is kept.
+// Infinity: no prediction
+std::vector<float> reprojectHits(const std::vector<float3>& positions, const std::vector<float>& heights, const SquareView& square)
+{
+    std::vector<float> predicted(size_t(square.width) * square.height, std::numeric_limits<float>::infinity());
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        float2 pixel;
+        if (heights[i] < 0 || !square.project(positions[i], pixel))
+            continue;
+        const float px = std::floor(pixel.x - 0.5f), py = std::floor(pixel.y - 0.5f);
+        for (int dy = 0; dy < 2; ++dy)
+        {
+            for (int dx = 0; dx < 2; ++dx)
+            {
+                const float x = px + dx, y = py + dy;
+                if (x < 0 || y < 0 || x >= square.width || y >= square.height)
+                    continue;
+                float& t = predicted[size_t(y) * square.width + size_t(x)];
+                t = std::min(t, 1 - heights[i]);
+            }
+        }
+    }
+    return predicted;
+}
+
+// The search of render() on the rays of a tile, without the shading. pixels: the pixel of every ray, whose stats
+// count its work. warm: where every ray starts (the warm start, see warmStartConeStep), the bracketed rays are not
+// traced; empty: all rays start on the top plate. The other rays go through the packets.
+std::vector<HMapIntersection> traceTileRays(PixelShader& shader, const ConeTexture& coneMap, bool usePackets, const std::vector<uint32_t>& pixels,
+                                            const std::vector<ConeStepRay>& rays, const std::vector<float>& footprints,
+                                            const std::vector<ConeStepWarmStart>& warm, StatsImage* pStats)
+{
+    std::vector<ConeStepHit> hits;
+    if (usePackets)
+    {
+        std::vector<ConeStepRay> traced;
+        std::vector<float> tracedStartSc;
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            if (!warm.empty() && warm[i].bracketed)
+                continue;
+            traced.push_back(rays[i]);
+            tracedStartSc.push_back(warm.empty() ? 0.0f : warm[i].startSc);
+        }
+        std::vector<ConeStepHit> tracedHits(traced.size());
+        traceConeStepPackets(shader.coneStepSettings(), coneMap, traced.data(), tracedHits.data(), traced.size(), tracedStartSc.data());
+        hits.resize(rays.size());
+        for (size_t i = 0, j = 0; i < rays.size(); ++i)
+            hits[i] = !warm.empty() && warm[i].bracketed ? warm[i].hit : tracedHits[j++];
+    }
+    std::vector<HMapIntersection> intersections(rays.size());
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        shader.stats = pStats ? &pStats->texels[pixels[i]] : nullptr;
+        const ConeStepRay& ray = rays[i];
+        shader.setRayStepBudget(ray.u, ray.u2, footprints.empty() ? 1.0f : footprints[i]);
+        if (!warm.empty() && shader.stats)
+        {
+            shader.stats->steps += warm[i].stepCount;
+            shader.stats->fetches += warm[i].stepCount;
+        }
+        if (!warm.empty() && warm[i].bracketed)
+        {
+            intersections[i] = {lerp(ray.u, ray.u2, warm[i].hit.t), warm[i].hit.t, warm[i].hit.lastT, true};
+            continue;
+        }
+        shader.rayStartSc = warm.empty() ? 0.0f : warm[i].startSc;
+        intersections[i] = usePackets ? shader.toIntersection(hits[i], ray.u, ray.u2) : shader.findIntersection(ray.u, ray.u2);
+    }
+    shader.rayStartSc = 0;
+    return intersections;
+}
+} // namespace
+
+RayView castRays(const RenderSettings& settings, const CameraSettings& camera, uint32_t width, uint32_t height)
+{
+    RayView view;
+    view.width = width;
+    view.height = height;
+    view.heightMapHeight = settings.heightMapHeight;
+    if (width == 0 || height == 0)
+        return view;
+    const SquareView square(settings, camera, width, height);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            ConeStepRay ray;
+            if (!square.castRay(x, y, ray))
+                continue;
+            view.pixels.push_back(y * width + x);
+            view.rays.push_back(ray);
+        }
+    }
+    return view;
+}
+
+float FloatMips::load(int32_t x, int32_t y, uint32_t mip) const
+{
+    if (mip >= mips.size())
+        return 0;
+    const LayoutImage<float>& m = mips[mip];
+    if (x < 0 || y < 0 || x >= (int32_t)m.width || y >= (int32_t)m.height)
+        return 0;
+    return m((uint32_t)x, (uint32_t)y);
+}
+
+float FloatMips::sampleLevel(float2 uv, uint32_t mip) const
+{
+    return sampleBilinear(mips[std::min(mip, getMipCount() - 1)], uv);
+}
+
+Renderer::Renderer(const HeightImage& heightmap) : mHeightmap(heightmap), mHeights(heightmap.width, heightmap.height)
+{
+    std::transform(heightmap.texels.begin(), heightmap.texels.end(), mHeights.texels.begin(), unorm16ToFloat);
+}
+
+void Renderer::setConeMap(ConeImage coneMap)
+{
+    mConeMap = std::move(coneMap);
+    mConeTexture = {};
+}
+
+void Renderer::setTexelLayout(TexelLayout layout, bool planarConeMap)
+{
+    mLayout = layout;
+    mPlanarConeMap = planarConeMap;
+    mHeightTexels = {};
+    mConeTexture = {};
+    mPyramidMax = {};
+    mPyramidCellMax = {};
+    mPyramidBorderMax = {};
+}
+
+void Renderer::setWarmStart(bool enable)
+{
+    mWarmStart = enable;
+    mHistoryPositions.clear();
+    mHistoryHeights.clear();
+}
+
+void Renderer::prepare(uint32_t parallaxFun, uint32_t shadowFun)
+{
+    if (mHeightTexels.empty())
+        mHeightTexels = LayoutImage<float>(mHeights, mLayout);
+    const bool usesConeMap = parallaxFun == 3 || parallaxFun == 13 || shadowFun >= 2;
+    if (usesConeMap && mConeMap.empty())
+        mConeMap = generateQuickConemap(QuickConemapSettings{}, mHeightmap);
+    if (usesConeMap && mConeTexture.empty())
+        mConeTexture = ConeTexture(mConeMap, mLayout, mPlanarConeMap);
+    if (parallaxFun >= 10 && parallaxFun <= 13 && mPyramidMax.mips.empty())
+        mPyramidMax = buildMaxMips(mHeights, mLayout);
+    if ((parallaxFun == 10 || parallaxFun == 13) && mPyramidCellMax.mips.empty())
+        mPyramidCellMax = buildMaxMips(neighbourMax(mHeights, 0, 1, 0, 1), mLayout);
+    if (parallaxFun == 12 && mPyramidBorderMax.mips.empty())
+        mPyramidBorderMax = buildMaxMips(neighbourMax(mHeights, -1, 1, -1, 1), mLayout);
+}
+
+Image<float3> Renderer::render(const RenderSettings& settings, const CameraSettings& camera, uint32_t width, uint32_t height, StatsImage* pStats)
+{
+    const float3 kClearColor = {1, 1, 1};
+    Image<float3> frame(width, height, kClearColor);
+    if (pStats)
+        *pStats = StatsImage(width, height);
+    if (mHeights.empty() || width == 0 || height == 0)
+        return frame;
+    prepare(settings.selectedParallaxFun, settings.selectedShadowFun);
+
+    const SquareView square(settings, camera, width, height);
+    PixelShader shader = makeShader(settings, mHeightTexels, mConeTexture, mPyramidMax, mPyramidCellMax, mPyramidBorderMax, mAlbedo, mProcedural);
+    shader.r1 = square.r1;
+    shader.r2 = square.r2;
+    shader.r3 = square.r3;
+
+    // the packets trace every lane with the same budget
+    const bool usePackets = mConeStepPackets && settings.selectedParallaxFun == 3 && !settings.ADAPTIVE_STEPS;
+    const bool warmStart = mWarmStart && settings.selectedParallaxFun == 3;
+    const std::vector<float> predictedT = warmStart ? reprojectHits(mHistoryPositions, mHistoryHeights, square) : std::vector<float>();
+    std::vector<float3> historyPositions(warmStart ? size_t(width) * height : 0);
+    std::vector<float> historyHeights(warmStart ? size_t(width) * height : 0, -1.0f);
+    const uint32_t n = mSupersampling;
+    const bool shareSteps = n > 1 && mShareSupersampleSteps && settings.selectedParallaxFun == 3;
+    const float sampleWeight = 1.0f / (n * n);
+    const uint32_t kTile = 32;
+    const uint32_t tilesX = (width + kTile - 1) / kTile, tilesY = (height + kTile - 1) / kTile;
+    parallelFor(0, tilesX * tilesY, [&](uint32_t tile)
+    {
+        // the rays of the tile's pixels, or of their n x n sub-samples, that hit the square
+        std::vector<uint32_t> pixels;
+        std::vector<ConeStepRay> rays;
+        std::vector<float> footprints;
+        std::vector<ConeStepWarmStart> warm;
+        // the central rays of the pixels whose sub-samples share their steps, and the range of the sub-samples
+        std::vector<ConeStepRay> beams;
+        std::vector<float> beamRadii;
+        std::vector<std::pair<size_t, size_t>> beamSamples;
+        pixels.reserve(kTile * kTile * n * n);
+        rays.reserve(kTile * kTile * n * n);
+        const uint32_t x0 = (tile % tilesX) * kTile, y0 = (tile / tilesX) * kTile;
+        for (uint32_t y = y0; y < std::min(y0 + kTile, height); ++y)
+        {
+            for (uint32_t x = x0; x < std::min(x0 + kTile, width); ++x)
+            {
+                const size_t first = rays.size();
+                for (uint32_t s = 0; s < n * n; ++s)
+                {
+                    ConeStepRay ray;
+                    if (!(n == 1 ? square.castRay(x, y, ray) : square.castRay(x + (s % n + 0.5f) / n, y + (s / n + 0.5f) / n, ray)))
+                        continue;
+                    pixels.push_back(y * width + x);
+                    rays.push_back(ray);
+                    if (settings.ADAPTIVE_STEPS)
+                        footprints.push_back(square.getFootprint(x, y, ray.u, shader.HMres) / n);
+                    // warm start: around the predicted hit, once the cone map certifies the ray above it
+                    if (warmStart && !shareSteps)
+                    {
+                        const float t = predictedT[y * width + x];
+                        warm.push_back(t == std::numeric_limits<float>::infinity()
+                                           ? ConeStepWarmStart()
+                                           : warmStartConeStep(mConeTexture, ray, t, kWarmStartBackoff, kWarmStartCertifySteps));
+                    }
+                }
+
+                // sharing: the beam around the pixel's central ray that contains its sub-samples
+                if (!shareSteps)
+                    continue;
+                warm.resize(rays.size());
+                ConeStepRay central;
+                if (rays.size() == first || !square.castRay(x, y, central))
+                    continue;
+                float radius = 0;
+                for (size_t i = first; i < rays.size(); ++i)
+                {
+                    const float2 a = rays[i].u - central.u, b = rays[i].u2 - central.u2;
+                    radius = std::max({radius, std::sqrt(a.x * a.x + a.y * a.y), std::sqrt(b.x * b.x + b.y * b.y)});
+                }
+                beams.push_back(central);
+                beamRadii.push_back(radius);
+                beamSamples.push_back({first, rays.size()});
+            }
+        }
+        // the beams step down to where the cones get narrower than the pixel, and the sub-samples start there
+        std::vector<float> beamT(beams.size());
+        std::vector<uint32_t> beamSteps(beams.size());
+        traceConeStepBeams(mConeTexture, beams.data(), beamRadii.data(), beams.size(), settings.stepNum, beamT.data(), beamSteps.data());
+        for (size_t b = 0; b < beams.size(); ++b)
+        {
+            for (size_t i = beamSamples[b].first; i < beamSamples[b].second; ++i)
+            {
+                const float2 d = rays[i].u2 - rays[i].u;
+                warm[i].startSc = beamT[b] * std::sqrt(d.x * d.x + d.y * d.y + 1); // t / ds.z
+            }
+            if (pStats)
+            {
+                pStats->texels[pixels[beamSamples[b].first]].steps += beamSteps[b];
+                pStats->texels[pixels[beamSamples[b].first]].fetches += beamSteps[b];
+            }
+        }
+        PixelShader tileShader = shader;
+        const std::vector<HMapIntersection> I = traceTileRays(tileShader, mConeTexture, usePackets, pixels, rays, footprints, warm, pStats);
+
+        // supersampling averages the sub-samples into their pixels, the missed ones are the clear color
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            tileShader.stats = pStats ? &pStats->texels[pixels[i]] : nullptr;
+            const ConeStepRay& ray = rays[i];
+            tileShader.setRayStepBudget(ray.u, ray.u2, footprints.empty() ? 1.0f : footprints[i]);
+            float3 col;
+            float t;
+            if (tileShader.shade(col, I[i], ray.u, ray.u2, &t))
+                frame.texels[pixels[i]] = n == 1 ? col : frame.texels[pixels[i]] + (col - kClearColor) * sampleWeight;
+            if (warmStart && PixelShader::getState(I[i], lerp(ray.u, ray.u2, t)) == TraceState::Hit)
+            {
+                historyPositions[pixels[i]] = square.toWorldPoint(lerp(ray.u, ray.u2, t), 1 - t);
+                historyHeights[pixels[i]] = 1 - t;
+            }
+        }
+    });
+    if (warmStart)
+    {
+        mHistoryPositions = std::move(historyPositions);
+        mHistoryHeights = std::move(historyHeights);
+    }
+    return frame;
+}
+
+RayHit Renderer::traceRay(const RenderSettings& settings, const ConeStepRay& ray, std::vector<TexelAccess>& texels, float footprint)
+{
+    RayHit hit;
+    if (mHeights.empty())
+        return hit;
+    prepare(settings.selectedParallaxFun, settings.selectedShadowFun);
+    PixelShader shader = makeShader(settings, mHeightTexels, mConeTexture, mPyramidMax, mPyramidCellMax, mPyramidBorderMax, mAlbedo, mProcedural);
+    shader.texels = &texels;
+    shader.setRayStepBudget(ray.u, ray.u2, footprint);
+    const HMapIntersection I = shader.findIntersection(ray.u, ray.u2);
+    hit.uv = shader.refineIntersection(I, ray.u, ray.u2, &hit.t);
+    hit.state = PixelShader::getState(I, hit.uv);
+    return hit;
+}
+
+void Renderer::traceRays(const RenderSettings& settings, const ConeStepRay* rays, RayHit* hits, size_t count, PixelStats* pStats, const float* pFootprints,
+                         const float* pStartT)
+{
+    if (mHeights.empty() || count == 0)
+        return;
+    prepareTracer(settings);
+
+    // chunks of the size of a render tile, in recording order
+    const size_t kChunk = 1024;
+    parallelFor(0, uint32_t((count + kChunk - 1) / kChunk), [&](uint32_t chunk)
+    {
+        const size_t first = chunk * kChunk, chunkCount = std::min(kChunk, count - first);
+        traceRaysPrepared(settings, rays + first, hits + first, chunkCount, pStats ? pStats + first : nullptr, pFootprints ? pFootprints + first : nullptr,
+                          pStartT ? pStartT + first : nullptr);
+    });
+}
+
+void Renderer::traceRaysPrepared(const RenderSettings& settings, const ConeStepRay* rays, RayHit* hits, size_t count, PixelStats* pStats,
+                                 const float* pFootprints, const float* pStartT) const
+{
+    if (mHeights.empty() || count == 0)
+        return;
+    PixelShader shader = makeShader(settings, mHeightTexels, mConeTexture, mPyramidMax, mPyramidCellMax, mPyramidBorderMax, mAlbedo, mProcedural);
+    // cone step mapping starts at the sc of the start, t / ds.z
+    const auto startSc = [&](size_t i)
+    {
+        const float2 d = rays[i].u2 - rays[i].u;
+        return pStartT ? pStartT[i] * std::sqrt(d.x * d.x + d.y * d.y + 1) : 0.0f;
+    };
+    const bool usePackets = mConeStepPackets && settings.selectedParallaxFun == 3 && !settings.ADAPTIVE_STEPS;
+    std::vector<ConeStepHit> coneHits;
+    if (usePackets)
+    {
+        std::vector<float> coneStartSc;
+        if (pStartT)
+        {
+            coneStartSc.resize(count);
+            for (size_t i = 0; i < count; ++i)
+                coneStartSc[i] = startSc(i);
+        }
+        coneHits.resize(count);
+        traceConeStepPackets(shader.coneStepSettings(), mConeTexture, rays, coneHits.data(), count, pStartT ? coneStartSc.data() : nullptr);
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        shader.stats = pStats ? &pStats[i] : nullptr;
+        const ConeStepRay& ray = rays[i];
+        shader.setRayStepBudget(ray.u, ray.u2, pFootprints ? pFootprints[i] : 1.0f);
+        shader.rayStartSc = startSc(i);
+        shader.rayStartT = pStartT ? pStartT[i] : 0.0f;
+        const HMapIntersection I = usePackets ? shader.toIntersection(coneHits[i], ray.u, ray.u2) : shader.findIntersection(ray.u, ray.u2);
+        RayHit& hit = hits[i];
+        hit.uv = shader.refineIntersection(I, ray.u, ray.u2, &hit.t);
+        hit.state = PixelShader::getState(I, hit.uv);
+        if (shader.stats)
+            shader.stats->state = hit.state;
+    }
+}
+} // namespace ParallaxCpu
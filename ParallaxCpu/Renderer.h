@@ -0,0 +1,118 @@
+#pragma once
+#include "Image.h"
+#include "Math.h"
+#include "ProceduralHeight.h"
+#include "RaySet.h"
+#include "RenderSettings.h"
+#include "TexelLayout.h"
+#include "TraceStats.h"
+#include <algorithm>
+#include <vector>
+
+namespace ParallaxCpu
+{
+// Mip chain of one float channel, sampled like the GPU textures (bilinear, clamped)
+struct FloatMips
+{
+    std::vector<LayoutImage<float>> mips;
+
+    uint32_t getMipCount() const { return (uint32_t)mips.size(); }
+    // Texture2D.Load: 0 outside of the mip
+    float load(int32_t x, int32_t y, uint32_t mip) const;
+    float sampleLevel(float2 uv, uint32_t mip) const;
+};
+
+// The ray of a recorded pixel after findIntersection_* and refineIntersection_*
+struct RayHit
+{
+    float2 uv;   // the refined intersection (u3 of Parallax.ps.slang)
+    float t = 0;   // uv = lerp(u, u2, t)
+    TraceState state = TraceState::None;
+};
+
+// The rays through the height field volume of the pixels of a frame that see the square, in scanline order
+RayView castRays(const RenderSettings& settings, const CameraSettings& camera, uint32_t width, uint32_t height);
+
+// CPU reference of Parallax::onFrameRender: the textured square drawn with Parallax.ps.slang.
+// Every pixel casts the camera ray onto the square, builds the tangent frame, runs the
+// findIntersection_* and refineIntersection_* ports and shades with the finite difference normal.
+// The frame is split into 32x32 pixel tiles that are spread over all cores; the rays of a tile are
+// set up first and then traced together, so cone step mapping can run them in SIMD packets.
+class Renderer
+{
+public:
+    explicit Renderer(const HeightImage& heightmap);
+
+    // The cone map of PARALLAX_FUN 3 and 13; the quick conemap (3x3 region growing) is baked when it is not set
+    void setConeMap(ConeImage coneMap);
+    // The texel order of the heights, the cone map and the pyramids the tracers read; planarConeMap:
+    // the heights and the cone tans of the cone map in two planes instead of interleaved like RG
+    void setTexelLayout(TexelLayout layout, bool planarConeMap = false);
+    // The height function that PARALLAX_FUN 14 traces directly, instead of the heightmap (which still gives HMres)
+    void setProceduralHeight(const ProceduralHeightSettings& procedural) { mProcedural = procedural; }
+    // Linear albedo, multiplied in like USE_ALBEDO_TEXTURE; empty: no albedo
+    void setAlbedo(Image<float3> albedo) { mAlbedo = std::move(albedo); }
+    // PARALLAX_FUN 3 traces simd::kLanes rays at once with traceConeStepPackets; false: one ray per pixel
+    void setConeStepPackets(bool enable) { mConeStepPackets = enable; }
+    // Temporal warm start of PARALLAX_FUN 3: render() keeps the hits of the frame, and the next frame reprojects
+    // them onto its pixels as predicted hits (warmStartConeStep). A ray that the cone map certifies empty down to
+    // half a texel above the prediction and that is below the surface half a texel after it skips cone stepping;
+    // a certified ray that is still above starts stepping there, the others start on the top plate.
+    // Enabling or disabling drops the kept hits.
+    void setWarmStart(bool enable);
+    // Supersampling: render() averages samplesPerAxis x samplesPerAxis sub-samples per pixel; 1: one ray per pixel.
+    // shareSteps (PARALLAX_FUN 3): cone step the pixel's central ray first, as a beam as wide as the sub-samples'
+    // offsets from it (traceConeStepBeam), and start every sub-sample where the beam stops, so only the final approach
+    // is traced per sub-sample. The sub-samples replace the temporal warm start.
+    void setSupersampling(uint32_t samplesPerAxis, bool shareSteps = true)
+    {
+        mSupersampling = std::max(1u, samplesPerAxis);
+        mShareSupersampleSteps = shareSteps;
+    }
+
+    // Linear colors; pixels that miss the square or are discarded get the white clear color.
+    // pStats: also count the work of every pixel's tracer like TRACE_STATS in Parallax.ps.slang
+    Image<float3> render(const RenderSettings& settings, const CameraSettings& camera, uint32_t width, uint32_t height, StatsImage* pStats = nullptr);
+
+    // The search and the refinement of render() on recorded rays, without the shading.
+    // pStats: count the work of every ray, count entries
+    // pFootprints: the texels the pixel of every ray covers (RaySet::getAllFootprints), for ADAPTIVE_STEPS; null: 1 texel
+    // pStartT: the ray parameter (lerp(u, u2, t)) at which the search of every ray starts, for PARALLAX_FUN 3, 10 and 12;
+    // the ray must be above the height field there. null: on the top plate
+    void traceRays(const RenderSettings& settings, const ConeStepRay* rays, RayHit* hits, size_t count, PixelStats* pStats = nullptr,
+                   const float* pFootprints = nullptr, const float* pStartT = nullptr);
+    // Builds the textures that the tracers of these settings read, which render() and traceRays() do on first use
+    void prepareTracer(const RenderSettings& settings) { prepare(settings.selectedParallaxFun, settings.selectedShadowFun); }
+    // traceRays on the calling thread, once prepareTracer ran for the same tracer: it only reads the renderer, so any
+    // number of threads can trace at once
+    void traceRaysPrepared(const RenderSettings& settings, const ConeStepRay* rays, RayHit* hits, size_t count, PixelStats* pStats = nullptr,
+                           const float* pFootprints = nullptr, const float* pStartT = nullptr) const;
+    // One ray of traceRays on the calling thread, appending every texel that the search and the refinement read
+    RayHit traceRay(const RenderSettings& settings, const ConeStepRay& ray, std::vector<TexelAccess>& texels, float footprint = 1.0f);
+
+private:
+    void prepare(uint32_t parallaxFun, uint32_t shadowFun);
+
+    HeightImage mHeightmap;
+    Image<float> mHeights; // row-major, for the bakes
+    ConeImage mConeMap;
+    TexelLayout mLayout = TexelLayout::RowMajor;
+    bool mPlanarConeMap = false;
+    // the textures of the tracers in mLayout, built on first use
+    LayoutImage<float> mHeightTexels;
+    ConeTexture mConeTexture;
+    Image<float3> mAlbedo;
+    ProceduralHeightSettings mProcedural;
+    bool mConeStepPackets = true;
+    bool mWarmStart = false;
+    // the hits of the last frame for the warm start: world positions and heights, < 0: the pixel had no hit
+    std::vector<float3> mHistoryPositions;
+    std::vector<float> mHistoryHeights;
+    uint32_t mSupersampling = 1;
+    bool mShareSupersampleSteps = true;
+    // the channels of HeightPyramid.cs.slang, built on first use
+    FloatMips mPyramidMax;       // .r
+    FloatMips mPyramidCellMax;   // .g
+    FloatMips mPyramidBorderMax; // .a
+};
+} // namespace ParallaxCpu
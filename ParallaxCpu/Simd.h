@@ -0,0 +1,355 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// The AVX2 backend is built for x86-64 targets; define PARALLAX_CPU_SIMD_AVX2 0 to leave it out
+#ifndef PARALLAX_CPU_SIMD_AVX2
+#if defined(__x86_64__) || defined(_M_X64)
+#define PARALLAX_CPU_SIMD_AVX2 1
+#else
+#define PARALLAX_CPU_SIMD_AVX2 0
+#endif
+#endif
+
+#if PARALLAX_CPU_SIMD_AVX2
+#include <immintrin.h>
+#if defined(__clang__)
+#define PARALLAX_CPU_AVX2_BEGIN _Pragma("clang attribute push(__attribute__((target(\"avx2\"))), apply_to = function)")
+#define PARALLAX_CPU_AVX2_END _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define PARALLAX_CPU_AVX2_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx2\")")
+#define PARALLAX_CPU_AVX2_END _Pragma("GCC pop_options")
+#else // MSVC compiles the intrinsics without /arch:AVX2
+#include <intrin.h>
+#define PARALLAX_CPU_AVX2_BEGIN
+#define PARALLAX_CPU_AVX2_END
+#endif
+// Calls backend::function of the kernels (SimdKernels.h) with the AVX2 lanes if the CPU has them
+#define PARALLAX_CPU_SIMD_CALL(function, ...) \
+    (::ParallaxCpu::simd::hasAvx2() ? ::ParallaxCpu::avx2::function(__VA_ARGS__) : ::ParallaxCpu::portable::function(__VA_ARGS__))
+#else
+#define PARALLAX_CPU_SIMD_CALL(function, ...) ::ParallaxCpu::portable::function(__VA_ARGS__)
+#endif
+
+// Minimal SIMD lane types for the CPU kernels, in two backends with the same lane count:
+// simd::avx2 maps the lanes to 256 bit registers, simd::portable is a fixed size array
+// implementation that the compiler is free to auto-vectorize.
+// Everything is compiled for the baseline of the target; only the AVX2 backend and the kernels
+// built with it (SimdKernels.h) get AVX2 code, through a function target and in namespaces of
+// their own. So no inline function or template the rest of the program also instantiates is
+// compiled for AVX2, and PARALLAX_CPU_SIMD_CALL runs the AVX2 kernels only on CPUs that have it.
+namespace ParallaxCpu::simd
+{
+// Both backends have 8 lanes; there is no AVX-512 backend with 16. The ray packets
+// (ConeStepPackets.h) are kLanes wide, so 16 wide packets would only need such a backend here.
+constexpr int kLanes = 8;
+
+// 2x2 reductions of two texel rows for the pyramid builder: dst[i] is the min (max) of
+// row0[2i], row0[2i + 1], row1[2i] and row1[2i + 1] for i < count, a multiple of kReduceWidth.
+// 8 bit texels are widened to 16 bit unorm (v * 257) on the way, which keeps their order.
+constexpr int kReduceWidth = 16;
+
+// True if the CPU and the OS support AVX2, checked once
+inline bool hasAvx2()
+{
+#if PARALLAX_CPU_SIMD_AVX2
+    static const bool supported = []()
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#else
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        // the OS has to save the 256 bit registers (OSXSAVE and the AVX state in XCR0)
+        __cpuid(info, 1);
+        if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#endif
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+} // namespace ParallaxCpu::simd
+
+// fixed size arrays
+namespace ParallaxCpu::simd::portable
+{
+using simd::kLanes;
+using simd::kReduceWidth;
+
+struct vmask
+{
+    int32_t v[kLanes];
+    vmask() = default;
+    explicit vmask(bool b) { for (int i = 0; i < kLanes; ++i) v[i] = b ? -1 : 0; }
+};
+
+struct vint
+{
+    int32_t v[kLanes];
+    vint() = default;
+    vint(int32_t s) { for (int i = 0; i < kLanes; ++i) v[i] = s; }
+    static vint iota(int32_t start) { vint r; for (int i = 0; i < kLanes; ++i) r.v[i] = start + i; return r; }
+    static vint load(const int32_t* p) { vint r; for (int i = 0; i < kLanes; ++i) r.v[i] = p[i]; return r; }
+    void store(int32_t* p) const { for (int i = 0; i < kLanes; ++i) p[i] = v[i]; }
+    int32_t operator[](int i) const { return v[i]; }
+};
+
+struct vfloat
+{
+    float v[kLanes];
+    vfloat() = default;
+    vfloat(float s) { for (int i = 0; i < kLanes; ++i) v[i] = s; }
+    static vfloat load(const float* p) { vfloat r; for (int i = 0; i < kLanes; ++i) r.v[i] = p[i]; return r; }
+    void store(float* p) const { for (int i = 0; i < kLanes; ++i) p[i] = v[i]; }
+    float operator[](int i) const { return v[i]; }
+};
+
+#define PARALLAX_CPU_LANEWISE(R, expr) R r; for (int i = 0; i < kLanes; ++i) r.v[i] = (expr); return r;
+
+inline vmask operator&(vmask a, vmask b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] & b.v[i]) }
+inline vmask operator|(vmask a, vmask b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] | b.v[i]) }
+inline vmask operator^(vmask a, vmask b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] ^ b.v[i]) }
+inline vmask operator!(vmask a) { PARALLAX_CPU_LANEWISE(vmask, ~a.v[i]) }
+inline vmask andNot(vmask a, vmask b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] & ~b.v[i]) }
+inline uint32_t bits(vmask a) { uint32_t r = 0; for (int i = 0; i < kLanes; ++i) r |= (a.v[i] ? 1u : 0u) << i; return r; }
+inline bool any(vmask a) { return bits(a) != 0; }
+inline bool all(vmask a) { return bits(a) == (1u << kLanes) - 1; }
+inline bool none(vmask a) { return bits(a) == 0; }
+
+inline vfloat operator+(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vfloat, a.v[i] + b.v[i]) }
+inline vfloat operator-(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vfloat, a.v[i] - b.v[i]) }
+inline vfloat operator*(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vfloat, a.v[i] * b.v[i]) }
+inline vfloat operator/(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vfloat, a.v[i] / b.v[i]) }
+inline vfloat operator-(vfloat a) { PARALLAX_CPU_LANEWISE(vfloat, -a.v[i]) }
+inline vfloat min(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vfloat, b.v[i] < a.v[i] ? b.v[i] : a.v[i]) }
+inline vfloat max(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vfloat, b.v[i] > a.v[i] ? b.v[i] : a.v[i]) }
+inline vfloat sqrt(vfloat a) { PARALLAX_CPU_LANEWISE(vfloat, std::sqrt(a.v[i])) }
+inline vfloat abs(vfloat a) { PARALLAX_CPU_LANEWISE(vfloat, std::fabs(a.v[i])) }
+inline vfloat floor(vfloat a) { PARALLAX_CPU_LANEWISE(vfloat, std::floor(a.v[i])) }
+inline vfloat select(vmask m, vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vfloat, m.v[i] ? a.v[i] : b.v[i]) }
+inline vmask operator<(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] < b.v[i] ? -1 : 0) }
+inline vmask operator<=(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] <= b.v[i] ? -1 : 0) }
+inline vmask operator>(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] > b.v[i] ? -1 : 0) }
+inline vmask operator>=(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] >= b.v[i] ? -1 : 0) }
+inline vmask operator==(vfloat a, vfloat b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] == b.v[i] ? -1 : 0) }
+
+inline vint operator+(vint a, vint b) { PARALLAX_CPU_LANEWISE(vint, a.v[i] + b.v[i]) }
+inline vint operator-(vint a, vint b) { PARALLAX_CPU_LANEWISE(vint, a.v[i] - b.v[i]) }
+inline vint operator*(vint a, vint b) { PARALLAX_CPU_LANEWISE(vint, a.v[i] * b.v[i]) }
+inline vint operator&(vint a, vint b) { PARALLAX_CPU_LANEWISE(vint, a.v[i] & b.v[i]) }
+inline vint operator|(vint a, vint b) { PARALLAX_CPU_LANEWISE(vint, a.v[i] | b.v[i]) }
+inline vint operator>>(vint a, int s) { PARALLAX_CPU_LANEWISE(vint, a.v[i] >> s) }
+inline vint operator<<(vint a, int s) { PARALLAX_CPU_LANEWISE(vint, int32_t(uint32_t(a.v[i]) << s)) }
+inline vint min(vint a, vint b) { PARALLAX_CPU_LANEWISE(vint, std::min(a.v[i], b.v[i])) }
+inline vint max(vint a, vint b) { PARALLAX_CPU_LANEWISE(vint, std::max(a.v[i], b.v[i])) }
+inline vint select(vmask m, vint a, vint b) { PARALLAX_CPU_LANEWISE(vint, m.v[i] ? a.v[i] : b.v[i]) }
+inline vmask operator==(vint a, vint b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] == b.v[i] ? -1 : 0) }
+inline vmask operator>(vint a, vint b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] > b.v[i] ? -1 : 0) }
+inline vmask operator<(vint a, vint b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] < b.v[i] ? -1 : 0) }
+inline vmask operator>=(vint a, vint b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] >= b.v[i] ? -1 : 0) }
+inline vmask operator<=(vint a, vint b) { PARALLAX_CPU_LANEWISE(vmask, a.v[i] <= b.v[i] ? -1 : 0) }
+
+inline vfloat toFloat(vint a) { PARALLAX_CPU_LANEWISE(vfloat, float(a.v[i])) }
+inline vint truncToInt(vfloat a) { PARALLAX_CPU_LANEWISE(vint, int32_t(a.v[i])) }
+
+inline vfloat gather(const float* base, vint idx, vmask m) { PARALLAX_CPU_LANEWISE(vfloat, m.v[i] ? base[idx.v[i]] : 0.0f) }
+inline vint gather(const int32_t* base, vint idx, vmask m) { PARALLAX_CPU_LANEWISE(vint, m.v[i] ? base[idx.v[i]] : 0) }
+inline vint gatherU16(const uint16_t* base, vint idx, vmask m) { PARALLAX_CPU_LANEWISE(vint, m.v[i] ? int32_t(base[idx.v[i]]) : 0) }
+
+#undef PARALLAX_CPU_LANEWISE
+
+inline vmask operator!=(vfloat a, vfloat b) { return !(a == b); }
+inline vmask operator!=(vint a, vint b) { return !(a == b); }
+inline vfloat clamp(vfloat a, vfloat lo, vfloat hi) { return min(max(a, lo), hi); }
+inline vfloat lerp(vfloat a, vfloat b, vfloat t) { return a + (b - a) * t; }
+
+// Mask of the first `count` lanes
+inline vmask firstLanes(int count) { return vint::iota(0) < vint(count); }
+
+// Horizontal reductions
+inline float reduceMin(vfloat a) { float r = a[0]; for (int i = 1; i < kLanes; ++i) r = std::min(r, a[i]); return r; }
+inline float reduceMax(vfloat a) { float r = a[0]; for (int i = 1; i < kLanes; ++i) r = std::max(r, a[i]); return r; }
+
+template<bool IsMax, typename T>
+inline void reduce2x2(const T* row0, const T* row1, uint16_t* dst, uint32_t count)
+{
+    const uint16_t scale = sizeof(T) == 1 ? 257 : 1;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const T a = IsMax ? std::max(row0[2 * i], row0[2 * i + 1]) : std::min(row0[2 * i], row0[2 * i + 1]);
+        const T b = IsMax ? std::max(row1[2 * i], row1[2 * i + 1]) : std::min(row1[2 * i], row1[2 * i + 1]);
+        dst[i] = uint16_t((IsMax ? std::max(a, b) : std::min(a, b)) * scale);
+    }
+}
+} // namespace ParallaxCpu::simd::portable
+
+#if PARALLAX_CPU_SIMD_AVX2
+// 256 bit registers
+PARALLAX_CPU_AVX2_BEGIN
+namespace ParallaxCpu::simd::avx2
+{
+using simd::kLanes;
+using simd::kReduceWidth;
+
+struct vmask
+{
+    __m256 v;
+    vmask() = default;
+    explicit vmask(__m256 m) : v(m) {}
+    explicit vmask(bool b) : v(_mm256_castsi256_ps(_mm256_set1_epi32(b ? -1 : 0))) {}
+};
+
+struct vint
+{
+    __m256i v;
+    vint() = default;
+    explicit vint(__m256i i) : v(i) {}
+    vint(int32_t s) : v(_mm256_set1_epi32(s)) {}
+    static vint iota(int32_t start) { return vint(_mm256_add_epi32(_mm256_set1_epi32(start), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))); }
+    static vint load(const int32_t* p) { return vint(_mm256_loadu_si256((const __m256i*)p)); }
+    void store(int32_t* p) const { _mm256_storeu_si256((__m256i*)p, v); }
+    int32_t operator[](int i) const { alignas(32) int32_t a[kLanes]; store(a); return a[i]; }
+};
+
+struct vfloat
+{
+    __m256 v;
+    vfloat() = default;
+    explicit vfloat(__m256 f) : v(f) {}
+    vfloat(float s) : v(_mm256_set1_ps(s)) {}
+    static vfloat load(const float* p) { return vfloat(_mm256_loadu_ps(p)); }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+    float operator[](int i) const { alignas(32) float a[kLanes]; store(a); return a[i]; }
+};
+
+inline vmask operator&(vmask a, vmask b) { return vmask(_mm256_and_ps(a.v, b.v)); }
+inline vmask operator|(vmask a, vmask b) { return vmask(_mm256_or_ps(a.v, b.v)); }
+inline vmask operator^(vmask a, vmask b) { return vmask(_mm256_xor_ps(a.v, b.v)); }
+inline vmask operator!(vmask a) { return vmask(_mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))); }
+inline vmask andNot(vmask a, vmask b) { return vmask(_mm256_andnot_ps(b.v, a.v)); } // a & !b
+inline uint32_t bits(vmask a) { return (uint32_t)_mm256_movemask_ps(a.v); }
+inline bool any(vmask a) { return bits(a) != 0; }
+inline bool all(vmask a) { return bits(a) == 0xFFu; }
+inline bool none(vmask a) { return bits(a) == 0; }
+
+inline vfloat operator+(vfloat a, vfloat b) { return vfloat(_mm256_add_ps(a.v, b.v)); }
+inline vfloat operator-(vfloat a, vfloat b) { return vfloat(_mm256_sub_ps(a.v, b.v)); }
+inline vfloat operator*(vfloat a, vfloat b) { return vfloat(_mm256_mul_ps(a.v, b.v)); }
+inline vfloat operator/(vfloat a, vfloat b) { return vfloat(_mm256_div_ps(a.v, b.v)); }
+inline vfloat operator-(vfloat a) { return vfloat(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))); }
+inline vfloat min(vfloat a, vfloat b) { return vfloat(_mm256_min_ps(a.v, b.v)); }
+inline vfloat max(vfloat a, vfloat b) { return vfloat(_mm256_max_ps(a.v, b.v)); }
+inline vfloat sqrt(vfloat a) { return vfloat(_mm256_sqrt_ps(a.v)); }
+inline vfloat abs(vfloat a) { return vfloat(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+inline vfloat floor(vfloat a) { return vfloat(_mm256_floor_ps(a.v)); }
+inline vfloat select(vmask m, vfloat a, vfloat b) { return vfloat(_mm256_blendv_ps(b.v, a.v, m.v)); }
+inline vmask operator<(vfloat a, vfloat b) { return vmask(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+inline vmask operator<=(vfloat a, vfloat b) { return vmask(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+inline vmask operator>(vfloat a, vfloat b) { return vmask(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+inline vmask operator>=(vfloat a, vfloat b) { return vmask(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)); }
+inline vmask operator==(vfloat a, vfloat b) { return vmask(_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)); }
+
+inline vint operator+(vint a, vint b) { return vint(_mm256_add_epi32(a.v, b.v)); }
+inline vint operator-(vint a, vint b) { return vint(_mm256_sub_epi32(a.v, b.v)); }
+inline vint operator*(vint a, vint b) { return vint(_mm256_mullo_epi32(a.v, b.v)); }
+inline vint operator&(vint a, vint b) { return vint(_mm256_and_si256(a.v, b.v)); }
+inline vint operator|(vint a, vint b) { return vint(_mm256_or_si256(a.v, b.v)); }
+inline vint operator>>(vint a, int s) { return vint(_mm256_srai_epi32(a.v, s)); }
+inline vint operator<<(vint a, int s) { return vint(_mm256_slli_epi32(a.v, s)); }
+inline vint min(vint a, vint b) { return vint(_mm256_min_epi32(a.v, b.v)); }
+inline vint max(vint a, vint b) { return vint(_mm256_max_epi32(a.v, b.v)); }
+inline vint select(vmask m, vint a, vint b) { return vint(_mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b.v), _mm256_castsi256_ps(a.v), m.v))); }
+inline vmask operator==(vint a, vint b) { return vmask(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a.v, b.v))); }
+inline vmask operator>(vint a, vint b) { return vmask(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a.v, b.v))); }
+inline vmask operator<(vint a, vint b) { return b > a; }
+inline vmask operator>=(vint a, vint b) { return !(b > a); }
+inline vmask operator<=(vint a, vint b) { return !(a > b); }
+
+inline vfloat toFloat(vint a) { return vfloat(_mm256_cvtepi32_ps(a.v)); }
+inline vint truncToInt(vfloat a) { return vint(_mm256_cvttps_epi32(a.v)); }
+
+// Masked gathers; inactive lanes return 0 and do not touch memory.
+inline vfloat gather(const float* base, vint idx, vmask m)
+{
+    return vfloat(_mm256_mask_i32gather_ps(_mm256_setzero_ps(), base, idx.v, m.v, 4));
+}
+inline vint gather(const int32_t* base, vint idx, vmask m)
+{
+    return vint(_mm256_mask_i32gather_epi32(_mm256_setzero_si256(), base, idx.v, _mm256_castps_si256(m.v), 4));
+}
+// 16 bit gather built on the 32 bit one: reads 4 bytes at every active lane,
+// so the source array needs one element of padding after its last texel.
+inline vint gatherU16(const uint16_t* base, vint idx, vmask m)
+{
+    __m256i r = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)base, idx.v, _mm256_castps_si256(m.v), 2);
+    return vint(_mm256_and_si256(r, _mm256_set1_epi32(0xFFFF)));
+}
+
+inline vmask operator!=(vfloat a, vfloat b) { return !(a == b); }
+inline vmask operator!=(vint a, vint b) { return !(a == b); }
+inline vfloat clamp(vfloat a, vfloat lo, vfloat hi) { return min(max(a, lo), hi); }
+inline vfloat lerp(vfloat a, vfloat b, vfloat t) { return a + (b - a) * t; }
+
+// Mask of the first `count` lanes
+inline vmask firstLanes(int count) { return vint::iota(0) < vint(count); }
+
+// Horizontal reductions
+inline float reduceMin(vfloat a) { float r = a[0]; for (int i = 1; i < kLanes; ++i) r = std::min(r, a[i]); return r; }
+inline float reduceMax(vfloat a) { float r = a[0]; for (int i = 1; i < kLanes; ++i) r = std::max(r, a[i]); return r; }
+
+template<bool IsMax>
+inline __m256i minMaxU16(__m256i a, __m256i b) { return IsMax ? _mm256_max_epu16(a, b) : _mm256_min_epu16(a, b); }
+template<bool IsMax>
+inline __m256i minMaxU8(__m256i a, __m256i b) { return IsMax ? _mm256_max_epu8(a, b) : _mm256_min_epu8(a, b); }
+
+template<bool IsMax>
+inline void reduce2x2(const uint16_t* row0, const uint16_t* row1, uint16_t* dst, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i += kReduceWidth)
+    {
+        __m256i lo = minMaxU16<IsMax>(_mm256_loadu_si256((const __m256i*)(row0 + 2 * i)), _mm256_loadu_si256((const __m256i*)(row1 + 2 * i)));
+        __m256i hi = minMaxU16<IsMax>(_mm256_loadu_si256((const __m256i*)(row0 + 2 * i + 16)), _mm256_loadu_si256((const __m256i*)(row1 + 2 * i + 16)));
+        // the horizontal pairs share a 32 bit lane, their result ends up in its low half
+        const __m256i lowHalf = _mm256_set1_epi32(0xFFFF);
+        lo = _mm256_and_si256(minMaxU16<IsMax>(lo, _mm256_srli_epi32(lo, 16)), lowHalf);
+        hi = _mm256_and_si256(minMaxU16<IsMax>(hi, _mm256_srli_epi32(hi, 16)), lowHalf);
+        // packus works per 128 bit half, the permute restores the texel order
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i*)(dst + i), packed);
+    }
+}
+
+template<bool IsMax>
+inline void reduce2x2(const uint8_t* row0, const uint8_t* row1, uint16_t* dst, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i += kReduceWidth)
+    {
+        __m256i v = minMaxU8<IsMax>(_mm256_loadu_si256((const __m256i*)(row0 + 2 * i)), _mm256_loadu_si256((const __m256i*)(row1 + 2 * i)));
+        v = _mm256_and_si256(minMaxU8<IsMax>(v, _mm256_srli_epi16(v, 8)), _mm256_set1_epi16(0xFF));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_mullo_epi16(v, _mm256_set1_epi16(257)));
+    }
+}
+} // namespace ParallaxCpu::simd::avx2
+PARALLAX_CPU_AVX2_END
+#endif
+
+// The kernels of each backend name its lanes simd::
+namespace ParallaxCpu::portable
+{
+namespace simd = ParallaxCpu::simd::portable;
+}
+#if PARALLAX_CPU_SIMD_AVX2
+namespace ParallaxCpu::avx2
+{
+namespace simd = ParallaxCpu::simd::avx2;
+}
+#endif
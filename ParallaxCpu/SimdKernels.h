@@ -0,0 +1,24 @@
+// No include guard: compiles the kernel file named by PARALLAX_CPU_SIMD_KERNELS once per SIMD
+// backend (Simd.h), into ParallaxCpu::portable and ParallaxCpu::avx2, where simd:: names the
+// lanes of that backend. The second copy is built for AVX2, so the kernel file must not include
+// anything itself: the headers it uses come first, and their inline functions stay baseline code.
+// Lane values do not pass through lambdas in the kernels, not every compiler builds those for
+// the target of the enclosing function. Functions the kernels call in their loops belong in the
+// kernel file too: calls from AVX2 code into baseline SSE code are slow.
+#include "Simd.h"
+
+namespace ParallaxCpu::portable
+{
+#include PARALLAX_CPU_SIMD_KERNELS
+} // namespace ParallaxCpu::portable
+
+#if PARALLAX_CPU_SIMD_AVX2
+PARALLAX_CPU_AVX2_BEGIN
+namespace ParallaxCpu::avx2
+{
+#include PARALLAX_CPU_SIMD_KERNELS
+} // namespace ParallaxCpu::avx2
+PARALLAX_CPU_AVX2_END
+#endif
+
+#undef PARALLAX_CPU_SIMD_KERNELS
@@ -0,0 +1,78 @@
+#include "TexelLayout.h"
+#include <algorithm>
+
+namespace ParallaxCpu
+{
+namespace
+{
+uint32_t ceilLog2(uint32_t v)
+{
+    uint32_t log2 = 0;
+    while ((1u << log2) < v)
+        ++log2;
+    return log2;
+}
+} // namespace
+
+const char* toString(TexelLayout layout)
+{
+    switch (layout)
+    {
+    case TexelLayout::RowMajor: return "row-major";
+    case TexelLayout::Tiled4x4: return "tiled 4x4";
+    case TexelLayout::Tiled8x8: return "tiled 8x8";
+    default: return "Morton";
+    }
+}
+
+bool parseTexelLayout(const std::string& name, TexelLayout& layout)
+{
+    const char* names[] = {"row", "tiled4", "tiled8", "morton"};
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        if (name == names[i])
+        {
+            layout = TexelLayout(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+TexelIndexer::TexelIndexer(TexelLayout l, uint32_t width, uint32_t height) : layout(l)
+{
+    switch (layout)
+    {
+    case TexelLayout::RowMajor: blockShift = 0; break;
+    case TexelLayout::Tiled4x4: blockShift = 2; break;
+    case TexelLayout::Tiled8x8: blockShift = 3; break;
+    default:
+        blockShift = std::min(ceilLog2(width), ceilLog2(height));
+        morton = blockShift > 0;
+        width = 1u << ceilLog2(width);
+        height = 1u << ceilLog2(height);
+        break;
+    }
+    const uint32_t block = 1u << blockShift;
+    blocksPerRow = (width + block - 1) >> blockShift;
+    blockRows = (height + block - 1) >> blockShift;
+}
+
+ConeTexture::ConeTexture(const ConeImage& coneMap, TexelLayout layout, bool planar)
+    : width(coneMap.width), height(coneMap.height), indexer(layout, coneMap.width, coneMap.height)
+{
+    const size_t count = indexer.getStorageSize();
+    stride = planar ? 1 : 2;
+    coneOffset = planar ? (uint32_t)count : 1;
+    values.assign(2 * count, 0.0f);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const size_t i = indexer(x, y) * stride;
+            values[i] = coneMap(x, y).x;
+            values[i + coneOffset] = coneMap(x, y).y;
+        }
+    }
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,106 @@
+#pragma once
+#include "Image.h"
+#include <string>
+
+namespace ParallaxCpu
+{
+// Texel orders of the CPU copies of the heightmap, the cone map and the pyramids, chosen when they are loaded.
+// Row-major rows put every step of a ray that moves in y on a new cache line; tiles and Z-order keep
+// 2D neighbourhoods together like the GPU's swizzled textures.
+enum class TexelLayout : uint32_t
+{
+    RowMajor,
+    Tiled4x4, // 4x4 texel blocks in row-major order, row-major inside a block
+    Tiled8x8,
+    Morton,   // Z-order inside square power of two blocks, the blocks in row-major order
+};
+
+const char* toString(TexelLayout layout);
+// The command line names: row, tiled4, tiled8, morton
+bool parseTexelLayout(const std::string& name, TexelLayout& layout);
+
+// Storage index of a texel in a layout. Tiled sizes are padded to whole blocks; Morton pads every
+// axis to a power of two, the blocks are as large as the shorter side.
+struct TexelIndexer
+{
+    TexelLayout layout = TexelLayout::RowMajor;
+    uint32_t blockShift = 0;   // log2 of the block side, 0 for row-major
+    uint32_t blocksPerRow = 0; // the row length for row-major
+    uint32_t blockRows = 0;
+    bool morton = false;
+
+    TexelIndexer() = default;
+    TexelIndexer(TexelLayout l, uint32_t width, uint32_t height);
+
+    size_t getStorageSize() const { return (size_t(blocksPerRow) * blockRows) << (2 * blockShift); }
+
+    size_t operator()(uint32_t x, uint32_t y) const
+    {
+        if (blockShift == 0)
+            return size_t(y) * blocksPerRow + x;
+        const uint32_t m = (1u << blockShift) - 1;
+        const size_t block = (size_t(y >> blockShift) * blocksPerRow + (x >> blockShift)) << (2 * blockShift);
+        return block + (morton ? spreadBits(x & m) | (spreadBits(y & m) << 1) : ((y & m) << blockShift) + (x & m));
+    }
+    // 0b1011 -> 0b1000101, for up to 16 bits
+    static uint32_t spreadBits(uint32_t v)
+    {
+        v = (v | (v << 8)) & 0x00FF00FFu;
+        v = (v | (v << 4)) & 0x0F0F0F0Fu;
+        v = (v | (v << 2)) & 0x33333333u;
+        return (v | (v << 1)) & 0x55555555u;
+    }
+};
+
+// Image with the texels in a layout; same interface as Image for the samplers
+template<typename T>
+struct LayoutImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    TexelIndexer indexer;
+    std::vector<T> texels; // padding texels are T()
+
+    LayoutImage() = default;
+    LayoutImage(uint32_t w, uint32_t h, TexelLayout layout = TexelLayout::RowMajor)
+        : width(w), height(h), indexer(layout, w, h), texels(indexer.getStorageSize())
+    {}
+    explicit LayoutImage(const Image<T>& image, TexelLayout layout = TexelLayout::RowMajor) : LayoutImage(image.width, image.height, layout)
+    {
+        for (uint32_t y = 0; y < height; ++y)
+            for (uint32_t x = 0; x < width; ++x)
+                (*this)(x, y) = image(x, y);
+    }
+
+    T& operator()(uint32_t x, uint32_t y) { return texels[indexer(x, y)]; }
+    const T& operator()(uint32_t x, uint32_t y) const { return texels[indexer(x, y)]; }
+    bool empty() const { return texels.empty(); }
+    TexelLayout getLayout() const { return indexer.layout; }
+};
+
+// The cone map in a layout, with [height, cone tan] interleaved like the RG textures or in two planes
+struct ConeTexture
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    TexelIndexer indexer;
+    uint32_t stride = 2;     // floats per storage index
+    uint32_t coneOffset = 1; // floats from the height of a texel to its cone tan
+    std::vector<float> values;
+
+    ConeTexture() = default;
+    explicit ConeTexture(const ConeImage& coneMap, TexelLayout layout = TexelLayout::RowMajor, bool planar = false);
+
+    float2 operator()(uint32_t x, uint32_t y) const
+    {
+        const size_t i = indexer(x, y) * stride;
+        return {values[i], values[i + coneOffset]};
+    }
+    bool empty() const { return values.empty(); }
+    bool isPlanar() const { return stride == 1; }
+};
+} // namespace ParallaxCpu
+
+// TexelIndexer for simd::kLanes texels, per SIMD backend
+#define PARALLAX_CPU_SIMD_KERNELS "TexelLayoutSimd.inl"
+#include "SimdKernels.h"
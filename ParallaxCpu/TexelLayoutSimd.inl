@@ -0,0 +1,23 @@
+// TexelIndexer for simd::kLanes texels, compiled per SIMD backend by SimdKernels.h (TexelLayout.h).
+// The storage must stay below 2^31 texels.
+
+// TexelIndexer::spreadBits of every lane
+inline simd::vint spreadBits(simd::vint v)
+{
+    using namespace simd;
+    v = (v | (v << 8)) & vint(0x00FF00FF);
+    v = (v | (v << 4)) & vint(0x0F0F0F0F);
+    v = (v | (v << 2)) & vint(0x33333333);
+    return (v | (v << 1)) & vint(0x55555555);
+}
+
+inline simd::vint indexTexels(const TexelIndexer& indexer, simd::vint x, simd::vint y)
+{
+    using namespace simd;
+    if (indexer.blockShift == 0)
+        return y * vint((int32_t)indexer.blocksPerRow) + x;
+    const int blockShift = (int)indexer.blockShift;
+    const vint m = (int32_t)(1u << blockShift) - 1;
+    const vint block = ((y >> blockShift) * vint((int32_t)indexer.blocksPerRow) + (x >> blockShift)) << (2 * blockShift);
+    return block + (indexer.morton ? spreadBits(x & m) | (spreadBits(y & m) << 1) : ((y & m) << blockShift) + (x & m));
+}
@@ -0,0 +1,198 @@
+#include "TextureCache.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace ParallaxCpu
+{
+namespace
+{
+const uint64_t kNoLine = ~uint64_t(0);
+
+uint64_t alignUp(uint64_t v, uint64_t alignment)
+{
+    return (v + alignment - 1) / alignment * alignment;
+}
+
+void getGroupSize(AccessGrouping grouping, uint32_t& width, uint32_t& height)
+{
+    switch (grouping)
+    {
+    case AccessGrouping::Pixel: width = 1; height = 1; break;
+    case AccessGrouping::Quad: width = 2; height = 2; break;
+    default: width = 8; height = 4; break;
+    }
+}
+} // namespace
+
+TextureCache::TextureCache(const TextureCacheSettings& settings, uint32_t heightmapWidth, uint32_t heightmapHeight) : mSettings(settings)
+{
+    mSettings.lineBytes = std::max(mSettings.lineBytes, 8u);
+    mSettings.ways = std::max(mSettings.ways, 1u);
+    mSetCount = std::max(1u, mSettings.sizeBytes / (mSettings.lineBytes * mSettings.ways));
+    mTags.assign(size_t(mSetCount) * mSettings.ways, kNoLine);
+
+    // the textures one after the other, mips included, every surface on a 64 KiB boundary
+    uint64_t address = 0;
+    const auto addTexture = [&](uint32_t texelBytes, bool withMips)
+    {
+        std::vector<Surface> mips;
+        uint32_t w = heightmapWidth, h = heightmapHeight;
+        for (;;)
+        {
+            Surface s;
+            s.base = address;
+            s.width = w;
+            s.height = h;
+            s.texelBytes = texelBytes;
+            uint64_t size;
+            if (mSettings.layout == TextureLayout::Linear)
+            {
+                s.pitch = (uint32_t)alignUp(uint64_t(w) * texelBytes, 256);
+                size = uint64_t(s.pitch) * h;
+            }
+            else
+            {
+                // 2^n texels per line as a block that is at most twice as wide as high
+                const uint32_t texelsPerLine = std::max(1u, mSettings.lineBytes / texelBytes);
+                uint32_t log2 = 0;
+                while ((2u << log2) <= texelsPerLine)
+                    ++log2;
+                s.blockWidth = 1u << ((log2 + 1) / 2);
+                s.blockHeight = (1u << log2) / s.blockWidth;
+                s.blocksPerRow = (w + s.blockWidth - 1) / s.blockWidth;
+                size = uint64_t(s.blocksPerRow) * ((h + s.blockHeight - 1) / s.blockHeight) * mSettings.lineBytes;
+            }
+            address = alignUp(address + size, 64 * 1024);
+            mips.push_back(s);
+            if (!withMips || (w == 1 && h == 1))
+                break;
+            w = std::max(1u, w / 2);
+            h = std::max(1u, h / 2);
+        }
+        mSurfaces.push_back(std::move(mips));
+    };
+    // in the order of TextureId
+    addTexture(settings.heightmapTexelBytes, false);
+    addTexture(settings.coneMapTexelBytes, false);
+    addTexture(settings.pyramidTexelBytes, true);
+}
+
+uint64_t TextureCache::getLine(const TexelAccess& texel) const
+{
+    const std::vector<Surface>& mips = mSurfaces[size_t(texel.texture)];
+    const Surface& s = mips[std::min<size_t>(texel.mip, mips.size() - 1)];
+    const uint32_t x = std::min(texel.x, s.width - 1), y = std::min(texel.y, s.height - 1);
+    if (mSettings.layout == TextureLayout::Linear)
+        return (s.base + uint64_t(y) * s.pitch + uint64_t(x) * s.texelBytes) / mSettings.lineBytes;
+    return s.base / mSettings.lineBytes + uint64_t(y / s.blockHeight) * s.blocksPerRow + x / s.blockWidth;
+}
+
+bool TextureCache::access(uint64_t line)
+{
+    uint64_t* ways = &mTags[size_t(line % mSetCount) * mSettings.ways];
+    uint64_t* last = ways + mSettings.ways - 1;
+    uint64_t* found = std::find(ways, last, line);
+    const bool hit = *found == line;
+    // move to the front; a miss drops the last way
+    std::copy_backward(ways, found, found + 1);
+    ways[0] = line;
+    return hit;
+}
+
+TextureCacheReport simulateTextureCache(Renderer& renderer, const RenderSettings& settings, const RaySet& set, const TextureCacheSettings& cacheSettings,
+                                        uint32_t heightmapWidth, uint32_t heightmapHeight)
+{
+    TextureCacheReport report;
+    report.lineBytes = std::max(cacheSettings.lineBytes, 8u);
+    TextureCache cache(cacheSettings, heightmapWidth, heightmapHeight);
+    uint32_t groupWidth, groupHeight;
+    getGroupSize(cacheSettings.grouping, groupWidth, groupHeight);
+    const uint32_t laneCount = groupWidth * groupHeight;
+
+    std::vector<std::vector<TexelAccess>> laneTexels(laneCount);
+    std::vector<std::vector<uint32_t>> laneFetches(laneCount); // the first texel of every fetch
+    std::vector<uint64_t> lines;
+    for (const RayView& view : set.views)
+    {
+        // the rays by group in screen order, then by lane
+        struct GroupedRay
+        {
+            uint64_t group;
+            uint32_t lane;
+            uint32_t ray;
+        };
+        std::vector<GroupedRay> order(view.rays.size());
+        const uint32_t groupsPerRow = (view.width + groupWidth - 1) / groupWidth;
+        for (uint32_t i = 0; i < (uint32_t)view.rays.size(); ++i)
+        {
+            const uint32_t x = view.pixels[i] % view.width, y = view.pixels[i] / view.width;
+            order[i] = {uint64_t(y / groupHeight) * groupsPerRow + x / groupWidth, (y % groupHeight) * groupWidth + x % groupWidth, i};
+        }
+        std::sort(order.begin(), order.end(), [](const GroupedRay& a, const GroupedRay& b) { return a.group != b.group ? a.group < b.group : a.lane < b.lane; });
+
+        for (size_t first = 0; first < order.size();)
+        {
+            size_t last = first;
+            uint32_t maxFetches = 0;
+            for (; last < order.size() && order[last].group == order[first].group; ++last)
+            {
+                const uint32_t lane = order[last].lane;
+                std::vector<TexelAccess>& texels = laneTexels[lane];
+                std::vector<uint32_t>& fetches = laneFetches[lane];
+                texels.clear();
+                fetches.clear();
+                renderer.traceRay(settings, view.rays[order[last].ray], texels);
+                for (uint32_t t = 0; t < (uint32_t)texels.size(); ++t)
+                    if (texels[t].newFetch || t == 0)
+                        fetches.push_back(t);
+                fetches.push_back((uint32_t)texels.size());
+                maxFetches = std::max(maxFetches, (uint32_t)fetches.size() - 1);
+                report.fetchCount += fetches.size() - 1;
+            }
+
+            // the n-th fetch of all lanes together
+            for (uint32_t f = 0; f < maxFetches; ++f)
+            {
+                lines.clear();
+                for (size_t r = first; r < last; ++r)
+                {
+                    const uint32_t lane = order[r].lane;
+                    const std::vector<uint32_t>& fetches = laneFetches[lane];
+                    if (f + 1 >= fetches.size())
+                        continue;
+                    for (uint32_t t = fetches[f]; t < fetches[f + 1]; ++t)
+                    {
+                        const uint64_t line = cache.getLine(laneTexels[lane][t]);
+                        if (std::find(lines.begin(), lines.end(), line) == lines.end())
+                            lines.push_back(line);
+                    }
+                }
+                for (uint64_t line : lines)
+                    report.hitCount += cache.access(line) ? 1 : 0;
+                report.requestCount += lines.size();
+            }
+            report.rayCount += last - first;
+            first = last;
+        }
+    }
+    return report;
+}
+
+std::string toString(const TextureCacheSettings& settings)
+{
+    const char* groupings[] = {"pixels", "2x2 quads", "8x4 warps"};
+    char text[256];
+    std::snprintf(text, sizeof(text), "%u KiB %u-way cache, %u B lines, %s textures, %s", settings.sizeBytes / 1024, settings.ways, settings.lineBytes,
+                  settings.layout == TextureLayout::Linear ? "linear" : "tiled", groupings[int(settings.grouping)]);
+    return text;
+}
+
+std::string toString(const TextureCacheReport& report)
+{
+    const double rays = std::max<double>(1, (double)report.rayCount);
+    char text[256];
+    std::snprintf(text, sizeof(text), "  per ray: %.2f fetches, %.2f line requests, %.2f%% hits, %.1f DRAM bytes\n", report.fetchCount / rays,
+                  report.requestCount / rays, 100 * report.getHitRate(), report.getDramBytesPerRay());
+    return text;
+}
+} // namespace ParallaxCpu
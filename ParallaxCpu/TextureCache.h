@@ -0,0 +1,82 @@
+#pragma once
+#include "RaySet.h"
+#include "Renderer.h"
+#include <string>
+#include <vector>
+
+namespace ParallaxCpu
+{
+enum class TextureLayout
+{
+    Linear, // rows of texels, the row pitch aligned to 256 bytes
+    Tiled,  // every cache line holds a square-ish block of texels
+};
+
+// How many pixels fetch in lockstep: the n-th fetch of all of them is one request per distinct line
+enum class AccessGrouping
+{
+    Pixel, // one pixel at a time
+    Quad,  // 2x2 pixels
+    Warp,  // 8x4 pixels
+};
+
+struct TextureCacheSettings
+{
+    uint32_t sizeBytes = 16 * 1024;
+    uint32_t ways = 4;
+    uint32_t lineBytes = 128;
+    TextureLayout layout = TextureLayout::Tiled;
+    AccessGrouping grouping = AccessGrouping::Warp;
+    // the 16 bit formats of the app; the pyramid has the border channel of QDM bilinear (RGBA)
+    uint32_t heightmapTexelBytes = 2;
+    uint32_t coneMapTexelBytes = 4;
+    uint32_t pyramidTexelBytes = 8;
+};
+
+// Set associative LRU cache over the texel addresses of the heightmap, the cone map and the pyramid
+class TextureCache
+{
+public:
+    TextureCache(const TextureCacheSettings& settings, uint32_t heightmapWidth, uint32_t heightmapHeight);
+
+    uint64_t getLine(const TexelAccess& texel) const;
+    // true: hit; a miss loads the line and evicts the least recently used one of its set
+    bool access(uint64_t line);
+
+private:
+    struct Surface
+    {
+        uint64_t base = 0;
+        uint32_t width = 0, height = 0;
+        uint32_t texelBytes = 0;
+        uint32_t pitch = 0;                       // Linear: bytes per row
+        uint32_t blockWidth = 0, blockHeight = 0; // Tiled: texels per line
+        uint32_t blocksPerRow = 0;
+    };
+
+    TextureCacheSettings mSettings;
+    uint32_t mSetCount = 0;
+    std::vector<std::vector<Surface>> mSurfaces; // [TextureId][mip]
+    std::vector<uint64_t> mTags;                 // ways per set, the most recently used first
+};
+
+struct TextureCacheReport
+{
+    size_t rayCount = 0;
+    uint64_t fetchCount = 0;   // fetch instructions of all rays
+    uint64_t requestCount = 0; // distinct lines per lockstep fetch
+    uint64_t hitCount = 0;
+    uint32_t lineBytes = 0;
+
+    double getHitRate() const { return requestCount ? double(hitCount) / requestCount : 0.0; }
+    double getDramBytesPerRay() const { return rayCount ? double(requestCount - hitCount) * lineBytes / rayCount : 0.0; }
+};
+
+// Replays the rays of the set with the settings' PARALLAX_FUN and REFINE_FUN on the calling thread and
+// streams the texels of every fetch through the cache, group after group in screen order
+TextureCacheReport simulateTextureCache(Renderer& renderer, const RenderSettings& settings, const RaySet& set, const TextureCacheSettings& cacheSettings,
+                                        uint32_t heightmapWidth, uint32_t heightmapHeight);
+
+std::string toString(const TextureCacheSettings& settings);
+std::string toString(const TextureCacheReport& report);
+} // namespace ParallaxCpu
@@ -0,0 +1,113 @@
+#include "TraceStats.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <vector>
+
+namespace ParallaxCpu
+{
+namespace
+{
+uint32_t getCounter(const PixelStats& p, TraceCounter counter)
+{
+    switch (counter)
+    {
+    case TraceCounter::Steps: return p.steps;
+    case TraceCounter::RefineSteps: return p.refineSteps;
+    default: return p.fetches;
+    }
+}
+
+// nearest rank percentiles of the sorted values
+CounterSummary summarize(std::vector<uint32_t>& values)
+{
+    CounterSummary s;
+    if (values.empty())
+        return s;
+    std::sort(values.begin(), values.end());
+    double sum = 0;
+    for (uint32_t v : values)
+        sum += v;
+    const auto percentile = [&](double p) { return values[std::min(values.size() - 1, size_t(p * values.size()))]; };
+    s.mean = sum / values.size();
+    s.p50 = percentile(0.50);
+    s.p95 = percentile(0.95);
+    s.p99 = percentile(0.99);
+    s.max = values.back();
+    return s;
+}
+} // namespace
+
+const CounterSummary& TraceStatsSummary::operator[](TraceCounter counter) const
+{
+    switch (counter)
+    {
+    case TraceCounter::Steps: return steps;
+    case TraceCounter::RefineSteps: return refineSteps;
+    default: return fetches;
+    }
+}
+
+TraceStatsSummary summarizeTraceStats(const StatsImage& stats)
+{
+    TraceStatsSummary summary;
+    std::vector<uint32_t> values[3];
+    for (const PixelStats& p : stats.texels)
+    {
+        if (p.state == TraceState::None)
+            continue;
+        ++summary.rayCount;
+        summary.hitCount += p.state == TraceState::Hit ? 1 : 0;
+        summary.notConvergedCount += p.state == TraceState::NotConverged ? 1 : 0;
+        summary.missedCount += p.state == TraceState::Missed ? 1 : 0;
+        values[0].push_back(p.steps);
+        values[1].push_back(p.refineSteps);
+        values[2].push_back(p.fetches);
+    }
+    summary.steps = summarize(values[0]);
+    summary.refineSteps = summarize(values[1]);
+    summary.fetches = summarize(values[2]);
+    return summary;
+}
+
+std::string toString(const TraceStatsSummary& summary)
+{
+    const auto percent = [&](uint32_t count) { return summary.rayCount ? 100.0 * count / summary.rayCount : 0.0; };
+    char text[512];
+    int length = std::snprintf(text, sizeof(text), "%u rays: %.2f%% hit, %.2f%% not converged, %.2f%% missed\n", summary.rayCount,
+                               percent(summary.hitCount), percent(summary.notConvergedCount), percent(summary.missedCount));
+    const char* names[] = {"steps", "refine steps", "fetches"};
+    for (int c = 0; c < 3; ++c)
+    {
+        const CounterSummary& s = summary[TraceCounter(c)];
+        length += std::snprintf(text + length, sizeof(text) - length, "  %-12s mean %6.2f  p50 %4u  p95 %4u  p99 %4u  max %4u\n", names[c], s.mean,
+                                s.p50, s.p95, s.p99, s.max);
+    }
+    return text;
+}
+
+Image<float3> makeHeatmap(const StatsImage& stats, TraceCounter counter, float scale)
+{
+    static const float3 kStops[] = {{0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0}};
+    const int kLastStop = int(std::size(kStops)) - 1;
+    Image<float3> heatmap(stats.width, stats.height);
+    for (size_t i = 0; i < stats.texels.size(); ++i)
+    {
+        const PixelStats& p = stats.texels[i];
+        if (p.state == TraceState::None)
+        {
+            heatmap.texels[i] = {1, 1, 1};
+            continue;
+        }
+        if (p.state == TraceState::NotConverged && counter != TraceCounter::RefineSteps)
+        {
+            heatmap.texels[i] = {1, 0, 1};
+            continue;
+        }
+        const float x = saturate(getCounter(p, counter) / std::max(scale, 1.0f)) * kLastStop;
+        const int stop = std::min(int(x), kLastStop - 1);
+        heatmap.texels[i] = lerp(kStops[stop], kStops[stop + 1], x - stop);
+    }
+    return heatmap;
+}
+} // namespace ParallaxCpu
@@ -0,0 +1,77 @@
+#pragma once
+#include "Image.h"
+#include "Math.h"
+#include <string>
+
+namespace ParallaxCpu
+{
+// What the ray of a pixel ended with; the w channel of gTraceStats in Parallax.ps.slang
+enum class TraceState : uint32_t
+{
+    None = 0,         // no ray: the pixel is not on the square
+    Hit = 1,          // converged on the height field
+    NotConverged = 2, // ran out of steps (magenta with displayNonConverged)
+    Missed = 3,       // left the texture (discarded or red)
+};
+
+// The work of one pixel's tracer, laid out like the RGBA32Uint texels of gTraceStats
+struct PixelStats
+{
+    uint32_t steps = 0;       // primary search iterations, and those of the shadow ray (SHADOW_FUN)
+    uint32_t refineSteps = 0; // refinement iterations
+    uint32_t fetches = 0;     // texture fetches of the search, the refinement and the shadow ray (not of the shading normal)
+    TraceState state = TraceState::None;
+};
+using StatsImage = Image<PixelStats>;
+
+// The GPU textures the tracers read; the max, cell max and border max pyramids are the channels of one texture
+enum class TextureId : uint8_t
+{
+    Heightmap, // gTexture of PARALLAX_FUN 1 and 2
+    ConeMap,   // gTexture of PARALLAX_FUN 3 and 13
+    Pyramid,   // gTexture of PARALLAX_FUN 11 and 12, MaxMipTexture of 10 and 13
+};
+
+// One texel read by a tracer; the texels of a bilinear fetch follow the first one
+struct TexelAccess
+{
+    TextureId texture = TextureId::Heightmap;
+    uint8_t mip = 0;
+    bool newFetch = true; // the first texel of a fetch instruction
+    uint32_t x = 0, y = 0;
+};
+
+enum class TraceCounter
+{
+    Steps,
+    RefineSteps,
+    Fetches,
+};
+
+struct CounterSummary
+{
+    double mean = 0;
+    uint32_t p50 = 0, p95 = 0, p99 = 0, max = 0;
+};
+
+// Over the pixels that have a ray
+struct TraceStatsSummary
+{
+    uint32_t rayCount = 0;
+    uint32_t hitCount = 0;
+    uint32_t notConvergedCount = 0;
+    uint32_t missedCount = 0;
+    CounterSummary steps, refineSteps, fetches;
+
+    const CounterSummary& operator[](TraceCounter counter) const;
+};
+
+TraceStatsSummary summarizeTraceStats(const StatsImage& stats);
+
+// A few lines for the log or the console
+std::string toString(const TraceStatsSummary& summary);
+
+// One counter as linear colors, from black (0) over blue, green and yellow to red (`scale` and above).
+// Pixels without a ray are white like the clear color, rays that did not converge are magenta.
+Image<float3> makeHeatmap(const StatsImage& stats, TraceCounter counter, float scale);
+} // namespace ParallaxCpu